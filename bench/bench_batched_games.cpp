@@ -0,0 +1,140 @@
+#include <bit>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "batched_games.h"
+#include "qtable.h"
+#include "space.h"
+
+namespace {
+    // xorshift64, both environments draw from the same cheap generator so the comparison measures the games
+    struct Random
+    {
+        uint64_t state;
+
+        uint32_t next()
+        {
+            state ^= state << 13;
+            state ^= state >> 7;
+            state ^= state << 17;
+            return static_cast<uint32_t>(state >> 32);
+        }
+
+        // a uniformly chosen set bit of a non-empty mask
+        int pick(uint32_t mask)
+        {
+            for (int skip = static_cast<int>(next() % std::popcount(mask)); skip > 0; --skip) {
+                mask &= mask - 1;
+            }
+            return std::countr_zero(mask);
+        }
+    };
+
+    struct Result
+    {
+        unsigned long long plies = 0, games = 0;
+        double seconds = 0.0;
+    };
+
+    // one game at a time on Space, the way the trainer plays
+    Result runScalar(const unsigned long long plies, const uint64_t seed)
+    {
+        Random random{seed};
+        Result result;
+        const auto start = std::chrono::steady_clock::now();
+        while (result.plies < plies) {
+            Space game;
+            for (signed char player = 0; ; player ^= 1) {
+                const int cell = random.pick(getLegalMoveMask(game));
+                game.place(cell % 3, cell / 3, player);
+                ++result.plies;
+                if (game.check_win(cell % 3, cell / 3) != -1 || getLegalMoveMask(game) == 0) {
+                    break;
+                }
+            }
+            ++result.games;
+        }
+        result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        return result;
+    }
+
+    // the whole batch in lockstep, finished games restart in place
+    Result runBatched(const unsigned long long plies, const uint32_t batch, const uint64_t seed)
+    {
+        Random random{seed};
+        BatchedGames games(batch);
+        std::vector<uint16_t> masks(batch);
+        std::vector<uint8_t> actions(batch, 0);
+        Result result;
+        const auto start = std::chrono::steady_clock::now();
+        while (result.plies < plies) {
+            games.legalMasks(masks.data());
+            for (uint32_t i = 0; i < batch; ++i) {
+                actions[i] = static_cast<uint8_t>(random.pick(masks[i]));
+            }
+            games.step(actions.data());
+            result.plies += batch;
+            result.games += games.resetFinished();
+        }
+        result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        return result;
+    }
+}
+
+// Random self-play throughput of the scalar Space loop against BatchedGames on one core.
+// usage: bench_batched_games [--plies N] [--batch B] [--seed S] [--format json|csv]
+int main(int argc, char **argv)
+{
+    unsigned long long plies = 20000000;
+    uint32_t batch = 4096;
+    uint64_t seed = 12345;
+    std::string format = "json";
+
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        const bool hasValue = i + 1 < argc;
+        if (arg == "--plies" && hasValue) {
+            plies = std::strtoull(argv[++i], nullptr, 10);
+        } else if (arg == "--batch" && hasValue) {
+            batch = std::strtoul(argv[++i], nullptr, 10);
+        } else if (arg == "--seed" && hasValue) {
+            seed = std::strtoull(argv[++i], nullptr, 10);
+        } else if (arg == "--format" && hasValue && (std::string(argv[i + 1]) == "json" || std::string(argv[i + 1]) == "csv")) {
+            format = argv[++i];
+        } else {
+            std::cerr << "usage: " << argv[0] << " [--plies N] [--batch B] [--seed S] [--format json|csv]\n";
+            return 1;
+        }
+    }
+    if (batch == 0 || seed == 0) {
+        std::cerr << "Error: --batch and --seed must not be 0\n";
+        return 1;
+    }
+
+    const Result scalar = runScalar(plies, seed);
+    const Result batched = runBatched(plies, batch, seed);
+
+    std::cout << std::fixed << std::setprecision(3);
+    if (format == "csv") {
+        std::cout << "env,batch,plies,games,seconds,plies_per_sec\n"
+                  << "scalar,1," << scalar.plies << ',' << scalar.games << ',' << scalar.seconds << ','
+                  << scalar.plies / scalar.seconds << '\n'
+                  << "batched," << batch << ',' << batched.plies << ',' << batched.games << ',' << batched.seconds
+                  << ',' << batched.plies / batched.seconds << '\n';
+        return 0;
+    }
+
+    std::cout << "{\n  \"seed\": " << seed << ",\n  \"runs\": ["
+              << "\n    {\"env\": \"scalar\", \"batch\": 1, \"plies\": " << scalar.plies
+              << ", \"games\": " << scalar.games << ", \"seconds\": " << scalar.seconds
+              << ", \"plies_per_sec\": " << scalar.plies / scalar.seconds << "},"
+              << "\n    {\"env\": \"batched\", \"batch\": " << batch << ", \"plies\": " << batched.plies
+              << ", \"games\": " << batched.games << ", \"seconds\": " << batched.seconds
+              << ", \"plies_per_sec\": " << batched.plies / batched.seconds << "}"
+              << "\n  ],\n  \"speedup\": " << (batched.plies / batched.seconds) / (scalar.plies / scalar.seconds)
+              << "\n}\n";
+    return 0;
+}
@@ -0,0 +1,39 @@
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include "training.h"
+#include "log.hpp"
+
+// Compare the per-thread-and-merge trainer against Hogwild mode (one shared table).
+// usage: bench_hogwild [episodes] [threads]
+int main(int argc, char **argv)
+{
+    const unsigned long long episodes = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1000000ULL;
+    const unsigned int threads = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 4;
+    const unsigned long long probeGames = 20000;
+
+    // keep the per-episode progress lines out of the measurement
+    debug::log_level = debug::ERROR;
+
+    std::cout << "mode,threads,episodes,seconds,episodes_per_sec,states,table_bytes,probe_win,probe_draw,probe_loss\n";
+    for (const bool hogwild : { false, true })
+    {
+        TrainingConfig config;
+        config.hogwild = hogwild;
+
+        const auto start = std::chrono::steady_clock::now();
+        const DenseQTable Q = train(episodes, threads, config);
+        const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        const ProbeResult probe = probeAgainstRandom(Q, probeGames, 42);
+
+        std::cout << std::fixed << std::setprecision(4)
+                  << (hogwild ? "hogwild" : "per_thread_merge") << ','
+                  << threads << ',' << episodes << ',' << seconds << ',' << episodes / seconds << ','
+                  << Q.size() << ',' << trainingTableBytes(Q, threads, hogwild) << ','
+                  << static_cast<double>(probe.wins) / probe.games() << ','
+                  << static_cast<double>(probe.draws) / probe.games() << ','
+                  << static_cast<double>(probe.losses) / probe.games() << '\n';
+    }
+}
@@ -0,0 +1,102 @@
+#include <algorithm>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "mcts.h"
+
+namespace {
+    std::vector<unsigned int> parseThreadList(const std::string &list)
+    {
+        std::vector<unsigned int> threads;
+        std::stringstream in(list);
+        for (std::string item; std::getline(in, item, ','); ) {
+            if (const auto count = std::strtoul(item.c_str(), nullptr, 10); count > 0) {
+                threads.push_back(count);
+            }
+        }
+        return threads;
+    }
+
+    // 1, 2, 4, ... up to the number of hardware threads
+    std::vector<unsigned int> defaultThreadList()
+    {
+        const unsigned int hardware = std::max(1u, std::thread::hardware_concurrency());
+        std::vector<unsigned int> threads;
+        for (unsigned int count = 1; count < hardware; count *= 2) {
+            threads.push_back(count);
+        }
+        threads.push_back(hardware);
+        return threads;
+    }
+}
+
+// MCTS search throughput: search the first move of an empty board for a fixed time with every
+// thread count of the sweep, to size the hardware for a target move latency.
+// usage: bench_mcts [--width W] [--height H] [--win K] [--seconds S] [--threads 1,2,4] [--format json|csv]
+int main(int argc, char **argv)
+{
+    int width = 15, height = 15, winLength = 5;
+    std::vector<unsigned int> threadList = defaultThreadList();
+    std::string format = "json";
+    MctsConfig config;
+    config.seed = 12345;
+
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        const bool hasValue = i + 1 < argc;
+        if (arg == "--width" && hasValue) {
+            width = std::atoi(argv[++i]);
+        } else if (arg == "--height" && hasValue) {
+            height = std::atoi(argv[++i]);
+        } else if (arg == "--win" && hasValue) {
+            winLength = std::atoi(argv[++i]);
+        } else if (arg == "--seconds" && hasValue) {
+            config.seconds = std::strtod(argv[++i], nullptr);
+        } else if (arg == "--threads" && hasValue) {
+            threadList = parseThreadList(argv[++i]);
+        } else if (arg == "--format" && hasValue && (std::string(argv[i + 1]) == "json" || std::string(argv[i + 1]) == "csv")) {
+            format = argv[++i];
+        } else {
+            std::cerr << "usage: " << argv[0] << " [--width W] [--height H] [--win K] [--seconds S]"
+                      << " [--threads 1,2,4] [--format json|csv]\n";
+            return 1;
+        }
+    }
+    if (config.seconds <= 0) {
+        std::cerr << "Error: --seconds must be positive\n";
+        return 1;
+    }
+
+    const Space game(width, height, winLength);
+    std::vector<std::pair<unsigned int, MctsResult>> results;
+    for (const unsigned int threads : threadList) {
+        config.threads = threads;
+        Mcts mcts(config);
+        results.emplace_back(threads, mcts.search(game, 0));
+    }
+
+    std::cout << std::fixed << std::setprecision(3);
+    if (format == "csv") {
+        std::cout << "width,height,win,threads,playouts,seconds,playouts_per_sec,nodes\n";
+        for (const auto &[threads, r] : results) {
+            std::cout << width << ',' << height << ',' << winLength << ',' << threads << ',' << r.playouts << ','
+                      << r.seconds << ',' << r.playoutsPerSecond() << ',' << r.nodes << '\n';
+        }
+        return 0;
+    }
+
+    std::cout << "{\n  \"width\": " << width << ",\n  \"height\": " << height << ",\n  \"win\": " << winLength
+              << ",\n  \"runs\": [";
+    for (size_t i = 0; i < results.size(); ++i) {
+        const auto &[threads, r] = results[i];
+        std::cout << (i ? "," : "") << "\n    {\"threads\": " << threads << ", \"playouts\": " << r.playouts
+                  << ", \"seconds\": " << r.seconds << ", \"playouts_per_sec\": " << r.playoutsPerSecond()
+                  << ", \"nodes\": " << r.nodes << "}";
+    }
+    std::cout << "\n  ]\n}\n";
+    return 0;
+}
@@ -0,0 +1,147 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "training.h"
+#include "log.hpp"
+
+#if defined(__unix__) || defined(__APPLE__)
+# include <sys/resource.h>
+#endif
+
+namespace {
+    struct Result
+    {
+        unsigned int threads;
+        double seconds;
+        TrainingStats stats;
+        uint64_t states;
+        uint64_t tableBytes;
+        long peakRssKb;
+    };
+
+    // High-water mark of the resident set of the whole process, in KiB (-1 if unknown).
+    // It never goes down, so the sweep runs thread counts in ascending order.
+    long peakRssKb()
+    {
+#if defined(__unix__) || defined(__APPLE__)
+        rusage usage{};
+        getrusage(RUSAGE_SELF, &usage);
+# ifdef __APPLE__
+        return usage.ru_maxrss / 1024;
+# else
+        return usage.ru_maxrss;
+# endif
+#else
+        return -1;
+#endif
+    }
+
+    std::vector<unsigned int> parseThreadList(const std::string &list)
+    {
+        std::vector<unsigned int> threads;
+        std::stringstream in(list);
+        for (std::string item; std::getline(in, item, ','); ) {
+            if (const auto count = std::strtoul(item.c_str(), nullptr, 10); count > 0) {
+                threads.push_back(count);
+            }
+        }
+        return threads;
+    }
+
+    // 1, 2, 4, ... up to the number of hardware threads
+    std::vector<unsigned int> defaultThreadList()
+    {
+        const unsigned int hardware = std::max(1u, std::thread::hardware_concurrency());
+        std::vector<unsigned int> threads;
+        for (unsigned int count = 1; count < hardware; count *= 2) {
+            threads.push_back(count);
+        }
+        threads.push_back(hardware);
+        return threads;
+    }
+}
+
+// End-to-end training throughput: self-play a fixed number of episodes with a fixed seed for every
+// thread count of the sweep and report one record per run.
+// usage: bench_trainer [--episodes N] [--seed S] [--threads 1,2,4] [--hogwild] [--no-symmetry] [--format json|csv]
+int main(int argc, char **argv)
+{
+    unsigned long long episodes = 500000;
+    std::vector<unsigned int> threadList = defaultThreadList();
+    std::string format = "json";
+    TrainingConfig config;
+    config.seed = 12345;
+
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        const bool hasValue = i + 1 < argc;
+        if (arg == "--episodes" && hasValue) {
+            episodes = std::strtoull(argv[++i], nullptr, 10);
+        } else if (arg == "--seed" && hasValue) {
+            config.seed = std::strtoull(argv[++i], nullptr, 10);
+        } else if (arg == "--threads" && hasValue) {
+            threadList = parseThreadList(argv[++i]);
+        } else if (arg == "--hogwild") {
+            config.hogwild = true;
+        } else if (arg == "--no-symmetry") {
+            config.useSymmetry = false;
+        } else if (arg == "--format" && hasValue && (std::string(argv[i + 1]) == "json" || std::string(argv[i + 1]) == "csv")) {
+            format = argv[++i];
+        } else {
+            std::cerr << "usage: " << argv[0] << " [--episodes N] [--seed S] [--threads 1,2,4] [--hogwild]"
+                      << " [--no-symmetry] [--format json|csv]\n";
+            return 1;
+        }
+    }
+
+    // keep the per-episode progress lines out of the measurement
+    debug::log_level = debug::ERROR;
+
+    std::vector<Result> results;
+    for (const unsigned int threads : threadList) {
+        Result result{};
+        result.threads = threads;
+        const auto start = std::chrono::steady_clock::now();
+        const DenseQTable Q = train(episodes, threads, config, {}, nullptr, 0, &result.stats);
+        result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        result.states = Q.size();
+        result.tableBytes = trainingTableBytes(Q, threads, config.hogwild);
+        result.peakRssKb = peakRssKb();
+        results.push_back(result);
+    }
+
+    const char *mode = config.hogwild ? "hogwild" : "per_thread_merge";
+    std::cout << std::fixed << std::setprecision(3);
+    if (format == "csv") {
+        std::cout << "mode,symmetry,seed,threads,episodes,plies,seconds,episodes_per_sec,plies_per_sec,"
+                     "states,table_bytes,peak_rss_kb\n";
+        for (const auto &r : results) {
+            std::cout << mode << ',' << config.useSymmetry << ',' << config.seed << ',' << r.threads << ','
+                      << r.stats.episodes << ',' << r.stats.plies << ',' << r.seconds << ','
+                      << r.stats.episodes / r.seconds << ',' << r.stats.plies / r.seconds << ','
+                      << r.states << ',' << r.tableBytes << ',' << r.peakRssKb << '\n';
+        }
+        return 0;
+    }
+
+    std::cout << "{\n  \"mode\": \"" << mode << "\",\n  \"symmetry\": " << (config.useSymmetry ? "true" : "false")
+              << ",\n  \"seed\": " << config.seed << ",\n  \"runs\": [";
+    for (size_t i = 0; i < results.size(); ++i) {
+        const auto &r = results[i];
+        std::cout << (i ? "," : "") << "\n    {\"threads\": " << r.threads
+                  << ", \"episodes\": " << r.stats.episodes << ", \"plies\": " << r.stats.plies
+                  << ", \"seconds\": " << r.seconds
+                  << ", \"episodes_per_sec\": " << r.stats.episodes / r.seconds
+                  << ", \"plies_per_sec\": " << r.stats.plies / r.seconds
+                  << ", \"states\": " << r.states << ", \"table_bytes\": " << r.tableBytes
+                  << ", \"peak_rss_kb\": " << r.peakRssKb << "}";
+    }
+    std::cout << "\n  ]\n}\n";
+    return 0;
+}
@@ -0,0 +1,304 @@
+#include <cerrno>
+#include <chrono>
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include "journal.h"
+#include "model.h"
+#include "move_server.h"
+#include "metrics.hpp"
+
+// Long-running AI move server: loads ai_model.dat once and serves many games at once over a
+// line-based protocol (see MoveServer), on stdin / stdout or on a Unix socket. Every request that
+// has arrived when the server wakes up is served as one batch. The model learns from every
+// finished game in memory, records each update in the model's journal and folds the journal into
+// the model in the background every --compact-every records.
+namespace {
+    volatile std::sig_atomic_t stopRequested = 0;
+
+    void requestStop(int) {
+        stopRequested = 1;
+    }
+
+    // Limits per connection, a client that exceeds one is disconnected: a request line longer
+    // than this, or more replies than this waiting because the client does not read them.
+    constexpr size_t maxLineBytes = 4096;
+    constexpr size_t maxPendingOutput = 1 << 20;
+
+    struct Connection
+    {
+        Connection(const int in, const int out) : in(in), out(out) { }
+
+        int in = -1, out = -1;
+        std::string input, output;
+        // the peer hung up or sent quit, close once the output is written
+        bool closing = false;
+        // the peer exceeded a limit, close at once
+        bool overflowed = false;
+    };
+
+    void printUsage(const char *program) {
+        std::cerr << "usage: " << program << " [options]\n"
+                  << "  --model <file>            model to serve and learn into (default ai_model.dat)\n"
+                  << "  --socket <path>           listen on a Unix socket instead of stdin / stdout\n"
+                  << "  --compact-every <n>       fold the journal into the model every n updates, 0 never (default 100000)\n"
+                  << "  --alpha <x>               learning rate of the online updates (default 0.1)\n"
+                  << "  --seed <n>                seed of the moves on unknown boards, 0 for random (default 0)\n"
+                  << "  --max-sessions <n>        open games per client (default 65536)\n"
+                  << "  --metrics <file>          write metrics in Prometheus text format to this file\n";
+    }
+
+    int listenOn(const std::string &path) {
+        sockaddr_un address{};
+        if (path.size() >= sizeof(address.sun_path)) {
+            std::cerr << "Error: socket path is too long.\n";
+            return -1;
+        }
+        address.sun_family = AF_UNIX;
+        std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+
+        const int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd < 0) {
+            std::cerr << "Error: socket: " << std::strerror(errno) << "\n";
+            return -1;
+        }
+        // a socket file left behind by an earlier run
+        unlink(path.c_str());
+        if (bind(fd, reinterpret_cast<sockaddr *>(&address), sizeof(address)) != 0 || listen(fd, SOMAXCONN) != 0) {
+            std::cerr << "Error: cannot listen on " << path << ": " << std::strerror(errno) << "\n";
+            close(fd);
+            return -1;
+        }
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+        return fd;
+    }
+
+    // read what is available, false once the peer has hung up
+    bool readInput(Connection &connection) {
+        char buffer[65536];
+        while (true) {
+            const ssize_t n = read(connection.in, buffer, sizeof(buffer));
+            if (n > 0) {
+                connection.input.append(buffer, n);
+                // stdin is blocking, one read per wake-up
+                if (static_cast<size_t>(n) < sizeof(buffer) || connection.in == STDIN_FILENO) {
+                    return true;
+                }
+            } else if (n == 0) {
+                return false;
+            } else {
+                return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+            }
+        }
+    }
+
+    // write what the peer takes, false if it is gone
+    bool writeOutput(Connection &connection) {
+        size_t written = 0;
+        while (written < connection.output.size()) {
+            const ssize_t n = write(connection.out, connection.output.data() + written, connection.output.size() - written);
+            if (n > 0) {
+                written += n;
+            } else if (n < 0 && errno == EINTR) {
+                continue;
+            } else if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+                break;
+            } else {
+                return false;
+            }
+        }
+        connection.output.erase(0, written);
+        return true;
+    }
+}
+
+int main(int argc, char **argv) {
+    std::string modelPath = "ai_model.dat";
+    std::string socketPath;
+    std::string metricsPath;
+    uint64_t compactEvery = 100000;
+    ServerConfig config;
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        const bool hasValue = i + 1 < argc;
+        if (arg == "--model" && hasValue) {
+            modelPath = argv[++i];
+        } else if (arg == "--socket" && hasValue) {
+            socketPath = argv[++i];
+        } else if (arg == "--compact-every" && hasValue) {
+            compactEvery = std::strtoull(argv[++i], nullptr, 10);
+        } else if (arg == "--alpha" && hasValue) {
+            config.alpha = std::strtod(argv[++i], nullptr);
+        } else if (arg == "--seed" && hasValue) {
+            config.seed = std::strtoull(argv[++i], nullptr, 10);
+        } else if (arg == "--max-sessions" && hasValue) {
+            config.maxSessionsPerClient = std::strtoul(argv[++i], nullptr, 10);
+        } else if (arg == "--metrics" && hasValue) {
+            metricsPath = argv[++i];
+        } else {
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+
+    // Map the model once, every session plays against it in place and learns into its updates,
+    // which start from the journal of updates since the model was last written.
+    OverlayModel model;
+    if (!model.open(modelPath) || model.base().size() == 0) {
+        std::cerr << "Error: Q table is empty. Exiting.\n";
+        return 1;
+    }
+    Journal journal;
+    uint64_t replayed = 0;
+    if (!journal.open(modelPath, model, &replayed)) {
+        return 1;
+    }
+    MoveServer server(model, config, &journal);
+
+    std::signal(SIGINT, requestStop);
+    std::signal(SIGTERM, requestStop);
+    std::signal(SIGPIPE, SIG_IGN);
+    if (!metricsPath.empty()) {
+        metrics::start_periodic_dump(metricsPath, std::chrono::seconds(5));
+    }
+
+    int listener = -1;
+    std::unordered_map<uint32_t, Connection> connections;
+    uint32_t nextClient = 0;
+    if (socketPath.empty()) {
+        connections.try_emplace(nextClient++, STDIN_FILENO, STDOUT_FILENO);
+    } else {
+        listener = listenOn(socketPath);
+        if (listener < 0) {
+            return 1;
+        }
+        std::cerr << "Serving " << modelPath << " (" << model.base().size() << " states, " << replayed << " journal updates) on "
+                  << socketPath << "\n";
+    }
+
+    std::vector<pollfd> fds;
+    std::vector<uint32_t> clientOf;
+    std::vector<ServerRequest> batch;
+    // journal records at which to compact next
+    uint64_t compactAt = compactEvery;
+
+    while (!stopRequested && (listener >= 0 || !connections.empty())) {
+        fds.clear();
+        clientOf.clear();
+        if (listener >= 0) {
+            fds.push_back({ listener, POLLIN, 0 });
+            clientOf.push_back(0);
+        }
+        for (const auto &[client, connection] : connections) {
+            if (!connection.closing) {
+                fds.push_back({ connection.in, POLLIN, 0 });
+                clientOf.push_back(client);
+            }
+            if (!connection.output.empty() && connection.out != STDOUT_FILENO) {
+                fds.push_back({ connection.out, POLLOUT, 0 });
+                clientOf.push_back(client);
+            }
+        }
+        if (poll(fds.data(), fds.size(), -1) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            std::cerr << "Error: poll: " << std::strerror(errno) << "\n";
+            break;
+        }
+
+        // gather every complete request line that has arrived into one batch
+        batch.clear();
+        for (size_t i = 0; i < fds.size(); ++i) {
+            if (fds[i].revents == 0) {
+                continue;
+            }
+            if (fds[i].fd == listener) {
+                for (int fd; (fd = accept(listener, nullptr, nullptr)) >= 0; ) {
+                    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+                    connections.try_emplace(nextClient++, fd, fd);
+                }
+                continue;
+            }
+            const auto it = connections.find(clientOf[i]);
+            if (it == connections.end() || !(fds[i].revents & (POLLIN | POLLHUP | POLLERR)) || fds[i].fd != it->second.in) {
+                continue;
+            }
+            Connection &connection = it->second;
+            if (!readInput(connection)) {
+                connection.closing = true;
+            }
+            size_t start = 0;
+            for (size_t end; (end = connection.input.find('\n', start)) != std::string::npos; start = end + 1) {
+                const std::string_view line(connection.input.data() + start, end - start);
+                if (line == "quit" || line == "quit\r") {
+                    connection.closing = true;
+                    start = connection.input.size();
+                    break;
+                }
+                batch.push_back({ it->first, std::string(line), {} });
+            }
+            connection.input.erase(0, start);
+            if (connection.input.size() > maxLineBytes) {
+                std::cerr << "Warning: client " << it->first << " sent a request line over " << maxLineBytes
+                          << " bytes, disconnected.\n";
+                connection.overflowed = true;
+            }
+        }
+
+        if (!batch.empty()) {
+            server.handle(batch);
+            for (const auto &request : batch) {
+                auto &connection = connections.at(request.client);
+                if (!connection.overflowed) {
+                    connection.output += request.reply;
+                    connection.output += '\n';
+                }
+            }
+        }
+
+        // write the replies, then retire connections that are done
+        for (auto it = connections.begin(); it != connections.end(); ) {
+            Connection &connection = it->second;
+            const bool alive = !connection.overflowed && writeOutput(connection);
+            if (alive && connection.output.size() > maxPendingOutput) {
+                std::cerr << "Warning: client " << it->first << " does not read its replies, disconnected.\n";
+            }
+            if (!alive || connection.output.size() > maxPendingOutput || (connection.closing && connection.output.empty())) {
+                server.dropClient(it->first);
+                if (connection.in != STDIN_FILENO) {
+                    close(connection.in);
+                }
+                it = connections.erase(it);
+            } else {
+                ++it;
+            }
+        }
+
+        // a compaction that cannot start (it failed, or an earlier one is still running) is retried
+        // once another compactEvery records have been journaled, not on every pass
+        if (compactEvery != 0 && journal.records() >= compactAt) {
+            compactAt = journal.compact(model, modelPath) ? compactEvery : journal.records() + compactEvery;
+        }
+    }
+
+    if (listener >= 0) {
+        close(listener);
+        unlink(socketPath.c_str());
+    }
+    journal.flush();
+    journal.waitForCompaction();
+    metrics::stop_periodic_dump();
+    std::cerr << "Served " << server.games() << " games, " << server.moves() << " AI moves.\n";
+    return 0;
+}
@@ -0,0 +1,291 @@
+#include <algorithm>
+#include <bit>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "space.h"
+#include "qtable.h"
+#include "symmetry.h"
+#include "model.h"
+#include "negamax.h"
+
+// Measure the strength of trained models: every model plays many 3x3 games in parallel against
+// baseline opponents, taking X in even and O in odd games, and the win / draw / loss rates are
+// reported with 95% Wilson score intervals.
+//   random   a uniformly random legal move
+//   greedy   wins at once if it can, otherwise blocks the opponent's immediate win, otherwise random
+//   perfect  a best move of the solved game (see negamax.h), ties broken at random; nobody beats it
+namespace {
+    enum class Opponent { random, greedy, perfect };
+
+    constexpr const char *opponentNames[] = { "random", "greedy", "perfect" };
+
+    struct Tally
+    {
+        unsigned long long wins = 0, draws = 0, losses = 0;
+
+        Tally &operator+=(const Tally &other) {
+            wins += other.wins;
+            draws += other.draws;
+            losses += other.losses;
+            return *this;
+        }
+        [[nodiscard]] unsigned long long games() const { return wins + draws + losses; }
+    };
+
+    // 95% Wilson score interval of a rate of k in n
+    std::pair<double, double> wilson(const unsigned long long k, const unsigned long long n) {
+        if (n == 0) {
+            return { 0.0, 1.0 };
+        }
+        constexpr double z = 1.959963984540054;
+        const double p = static_cast<double>(k) / n;
+        const double denominator = 1 + z * z / n;
+        const double center = (p + z * z / (2.0 * n)) / denominator;
+        const double half = z * std::sqrt(p * (1 - p) / n + z * z / (4.0 * n * n)) / denominator;
+        return { std::max(0.0, center - half), std::min(1.0, center + half) };
+    }
+
+    // the n-th empty cell of a mask at random
+    template <typename Generator>
+    int randomCell(const uint32_t legalMoves, Generator &gen) {
+        std::uniform_int_distribution<> moveDis(0, std::popcount(legalMoves) - 1);
+        uint32_t moves = legalMoves;
+        for (int skip = moveDis(gen); skip > 0; --skip) {
+            moves &= moves - 1;
+        }
+        return std::countr_zero(moves);
+    }
+
+    // first legal cell where player would complete a line, -1 if there is none
+    int winningCell(Space &game, const uint32_t legalMoves, const signed char player) {
+        for (uint32_t moves = legalMoves; moves; moves &= moves - 1) {
+            const int cell = std::countr_zero(moves);
+            game.make_move(cell % 3, cell / 3, player);
+            const bool won = game.check_win(cell % 3, cell / 3) == player;
+            game.unmake_move(cell % 3, cell / 3, player);
+            if (won) {
+                return cell;
+            }
+        }
+        return -1;
+    }
+
+    // greedy move of a trained model, random on boards it has never seen
+    template <typename Generator>
+    int modelMove(const DenseQTable &Q, const Space &game, const signed char player, Generator &gen) {
+        uint32_t row = getStateIndex(game, player == 0 ? 'X' : 'O');
+        uint8_t transform = 0;
+        if (Q.isCanonical()) {
+            const auto [slot, frame] = canonicalize(row);
+            row = slot;
+            transform = frame;
+        }
+        const uint32_t legalMoves = getLegalMoveMask(game);
+        if (!Q.isVisited(row)) {
+            return randomCell(legalMoves, gen);
+        }
+        const double *q = Q.row(row);
+        const uint32_t moves = transformMask(legalMoves, transform);
+        int best = std::countr_zero(moves);
+        for (uint32_t rest = moves; rest; rest &= rest - 1) {
+            if (const int a = std::countr_zero(rest); q[a] > q[best]) {
+                best = a;
+            }
+        }
+        return inverseTransformCell(best, transform);
+    }
+
+    template <typename Generator>
+    int opponentMove(const Opponent opponent, const DenseQTable &perfect, Space &game, const signed char player,
+                     Generator &gen) {
+        const uint32_t legalMoves = getLegalMoveMask(game);
+        switch (opponent) {
+        case Opponent::random:
+            break;
+        case Opponent::greedy:
+            if (const int cell = winningCell(game, legalMoves, player); cell >= 0) {
+                return cell;
+            }
+            if (const int cell = winningCell(game, legalMoves, static_cast<signed char>(1 - player)); cell >= 0) {
+                return cell;
+            }
+            break;
+        case Opponent::perfect: {
+            // pick uniformly among the moves of the best value
+            const double *q = perfect.row(getStateIndex(game, player == 0 ? 'X' : 'O'));
+            double bestValue = -2.0;
+            uint32_t best = 0;
+            for (uint32_t moves = legalMoves; moves; moves &= moves - 1) {
+                const int a = std::countr_zero(moves);
+                if (q[a] > bestValue) {
+                    bestValue = q[a];
+                    best = 0;
+                }
+                if (q[a] == bestValue) {
+                    best |= 1u << a;
+                }
+            }
+            return randomCell(best, gen);
+        }
+        }
+        return randomCell(legalMoves, gen);
+    }
+
+    // games [first, last) of one pairing, the model is X in even games and O in odd ones
+    Tally playGames(const DenseQTable &Q, const DenseQTable &perfect, const Opponent opponent,
+                    const unsigned long long first, const unsigned long long last, const uint64_t seed) {
+        std::mt19937_64 gen(seed);
+        Space game;
+        Tally tally;
+        for (unsigned long long g = first; g < last; ++g) {
+            const auto agent = static_cast<signed char>(g % 2);
+            game.clear();
+            for (signed char player = 0; ; player = static_cast<signed char>(1 - player)) {
+                const int cell = player == agent
+                    ? modelMove(Q, game, player, gen)
+                    : opponentMove(opponent, perfect, game, player, gen);
+                game.make_move(cell % 3, cell / 3, player);
+
+                if (game.check_win(cell % 3, cell / 3) == player) {
+                    ++(player == agent ? tally.wins : tally.losses);
+                    break;
+                }
+                if (getLegalMoveMask(game) == 0) {
+                    ++tally.draws;
+                    break;
+                }
+            }
+        }
+        return tally;
+    }
+
+    std::string rate(const unsigned long long k, const unsigned long long n) {
+        const auto [low, high] = wilson(k, n);
+        std::ostringstream out;
+        out << std::fixed << std::setprecision(3) << 100.0 * k / std::max(1ull, n) << "% ["
+            << 100.0 * low << ", " << 100.0 * high << "]";
+        return out.str();
+    }
+
+    void printUsage(const char *program) {
+        std::cerr << "usage: " << program << " [options] <model>...\n"
+                  << "  --games <n>               games per model and opponent (default 1000000)\n"
+                  << "  --threads <n>             worker threads, 0 for one per hardware thread (default 0)\n"
+                  << "  --opponents <list>        comma separated from random, greedy, perfect (default all)\n"
+                  << "  --seed <n>                seed of the games, thread t uses seed + t, 0 for random (default 0)\n"
+                  << "  --max-loss-rate <x>       exit with status 2 if a model loses more than this fraction\n"
+                  << "                            of its games against any opponent, to gate deploys\n";
+    }
+}
+
+int main(int argc, char **argv) {
+    unsigned long long games = 1000000;
+    unsigned int threads = 0;
+    uint64_t seed = 0;
+    double maxLossRate = -1.0;
+    std::vector<Opponent> opponents = { Opponent::random, Opponent::greedy, Opponent::perfect };
+    std::vector<std::string> modelPaths;
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        const bool hasValue = i + 1 < argc;
+        if (arg == "--games" && hasValue) {
+            games = std::strtoull(argv[++i], nullptr, 10);
+        } else if (arg == "--threads" && hasValue) {
+            threads = std::strtoul(argv[++i], nullptr, 10);
+        } else if (arg == "--seed" && hasValue) {
+            seed = std::strtoull(argv[++i], nullptr, 10);
+        } else if (arg == "--max-loss-rate" && hasValue) {
+            maxLossRate = std::strtod(argv[++i], nullptr);
+        } else if (arg == "--opponents" && hasValue) {
+            opponents.clear();
+            std::istringstream list(argv[++i]);
+            for (std::string name; std::getline(list, name, ','); ) {
+                const auto it = std::ranges::find(opponentNames, name);
+                if (it == std::end(opponentNames)) {
+                    printUsage(argv[0]);
+                    return 1;
+                }
+                opponents.push_back(static_cast<Opponent>(it - std::begin(opponentNames)));
+            }
+        } else if (!arg.starts_with("--")) {
+            modelPaths.push_back(arg);
+        } else {
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+    if (modelPaths.empty() || games == 0 || opponents.empty()) {
+        printUsage(argv[0]);
+        return 1;
+    }
+    if (threads == 0) {
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    if (seed == 0) {
+        seed = std::random_device{}();
+    }
+
+    // the perfect opponent plays from the solved game, raw (not canonical) rows for direct lookups
+    const DenseQTable perfect = solvedQTable(false);
+
+    bool gatePassed = true;
+    for (const auto &path : modelPaths) {
+        DenseQTable Q;
+        if (isBinaryModel(path)) {
+            MappedModel model;
+            if (!model.open(path)) {
+                return 1;
+            }
+            Q = model.toDenseQTable();
+        } else {
+            Q.fromQTable(loadQTable(path));
+        }
+        if (Q.size() == 0) {
+            std::cerr << "Error: " << path << " holds no Q table.\n";
+            return 1;
+        }
+        std::cout << path << " (" << Q.size() << (Q.isCanonical() ? " canonical" : "") << " states)\n";
+
+        for (const Opponent opponent : opponents) {
+            const auto start = std::chrono::steady_clock::now();
+            std::vector<Tally> tallies(threads);
+            std::vector<std::thread> workers;
+            workers.reserve(threads);
+            for (unsigned int t = 0; t < threads; ++t) {
+                workers.emplace_back([&, t] {
+                    tallies[t] = playGames(Q, perfect, opponent, games * t / threads, games * (t + 1) / threads, seed + t);
+                });
+            }
+            Tally total;
+            for (unsigned int t = 0; t < threads; ++t) {
+                workers[t].join();
+                total += tallies[t];
+            }
+            const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+            const auto n = total.games();
+            std::cout << "  vs " << std::left << std::setw(8) << opponentNames[static_cast<int>(opponent)] << std::right
+                      << n << " games  win " << rate(total.wins, n) << "  draw " << rate(total.draws, n)
+                      << "  loss " << rate(total.losses, n) << "  " << std::fixed << std::setprecision(0)
+                      << n / seconds << " games/sec\n";
+            if (maxLossRate >= 0 && static_cast<double>(total.losses) / n > maxLossRate) {
+                gatePassed = false;
+            }
+        }
+    }
+
+    if (!gatePassed) {
+        std::cout << std::defaultfloat << "FAILED: a model loses more than " << maxLossRate * 100
+                  << "% of its games against an opponent.\n";
+        return 2;
+    }
+    return 0;
+}
@@ -0,0 +1,86 @@
+#include "batched_games.h"
+
+namespace {
+    constexpr uint16_t fullBoard = (1u << boardCells) - 1;
+
+    // rows, columns and diagonals of the 3x3 board as stone masks
+    constexpr uint16_t lines[8] = { 0007, 0070, 0700, 0111, 0222, 0444, 0421, 0124 };
+
+    // The kernels take the arrays as restrict parameters: they never overlap, and saying so lets
+    // the compiler vectorize the loops without runtime alias checks. Every operation is done for
+    // every game and masked by whether it is still running, there is no branch per game.
+
+    void stepGames(const uint32_t n, const uint8_t *__restrict action, uint16_t *__restrict x, uint16_t *__restrict o,
+                   uint8_t *__restrict side, uint8_t *__restrict moves, uint8_t *__restrict over,
+                   int8_t *__restrict won) {
+        for (uint32_t i = 0; i < n; ++i) {
+            const auto live = static_cast<uint16_t>(over[i] ^ 1);
+            const auto isO = static_cast<uint16_t>(side[i]);
+            // one compare per cell instead of a variable shift, which SSE2 has no vector form of
+            uint16_t stone = 0;
+            for (uint16_t cell = 0; cell < boardCells; ++cell) {
+                stone |= static_cast<uint16_t>((action[i] == cell) << cell);
+            }
+            stone &= -live;
+            x[i] |= stone & (isO - 1);
+            o[i] |= stone & -isO;
+
+            const uint16_t mine = isO ? o[i] : x[i];
+            uint16_t line = 0;
+            for (const uint16_t mask : lines) {
+                line |= (mine & mask) == mask;
+            }
+            const auto full = static_cast<uint16_t>((x[i] | o[i]) == fullBoard);
+            const auto ended = static_cast<uint16_t>(live & (line | full));
+
+            won[i] = ended ? static_cast<int8_t>(line ? isO : BatchedGames::draw) : won[i];
+            over[i] |= ended;
+            moves[i] += live;
+            side[i] ^= live & (ended ^ 1);
+        }
+    }
+
+    uint32_t resetGames(const uint32_t n, uint16_t *__restrict x, uint16_t *__restrict o, uint8_t *__restrict side,
+                        uint8_t *__restrict moves, uint8_t *__restrict over, int8_t *__restrict won) {
+        uint32_t reset = 0;
+        for (uint32_t i = 0; i < n; ++i) {
+            const auto keep = static_cast<uint8_t>(over[i] - 1);  // 0xff while running, 0 once finished
+            reset += over[i];
+            x[i] &= static_cast<uint16_t>(static_cast<int8_t>(keep));
+            o[i] &= static_cast<uint16_t>(static_cast<int8_t>(keep));
+            side[i] &= keep;
+            moves[i] &= keep;
+            won[i] = over[i] ? BatchedGames::running : won[i];
+            over[i] = 0;
+        }
+        return reset;
+    }
+}
+
+BatchedGames::BatchedGames(const uint32_t count)
+    : count(count), xStones(count, 0), oStones(count, 0), toMove(count, 0), plies(count, 0), done(count, 0),
+      winners(count, running)
+{
+}
+
+void BatchedGames::legalMasks(uint16_t *masks) const {
+    const uint16_t *x = xStones.data(), *o = oStones.data();
+    const uint8_t *over = done.data();
+    for (uint32_t i = 0; i < count; ++i) {
+        masks[i] = static_cast<uint16_t>(~(x[i] | o[i]) & fullBoard & (over[i] - 1));
+    }
+}
+
+void BatchedGames::stateIndices(uint32_t *states) const {
+    for (uint32_t i = 0; i < count; ++i) {
+        states[i] = getStateIndex(xStones[i], oStones[i], toMove[i] == 0 ? 'X' : 'O');
+    }
+}
+
+void BatchedGames::step(const uint8_t *actions) {
+    stepGames(count, actions, xStones.data(), oStones.data(), toMove.data(), plies.data(), done.data(), winners.data());
+}
+
+uint32_t BatchedGames::resetFinished() {
+    return resetGames(count, xStones.data(), oStones.data(), toMove.data(), plies.data(), done.data(), winners.data());
+}
@@ -0,0 +1,119 @@
+#include <bit>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "qtable.h"
+#include "model.h"
+#include "symmetry.h"
+
+// Compile a trained model into a C++ header: a constexpr table of the greedy action of every
+// 3x3 state, indexed by the dense state index (see getStateIndex), for builds that play without
+// reading a model file (play_embedded). Actions are cells y * 3 + x in the board's own frame, -1
+// for states the model has no entry for or where no move is left.
+// usage: gen_policy <model> <header>
+//   model: binary or text model, e.g. ai_model.dat or the output of solver
+namespace {
+    // bit mask of the empty cells of the board of a dense state index
+    uint32_t emptyCellsOf(uint32_t state) {
+        uint32_t empty = 0;
+        state >>= 1;
+        for (uint32_t cell = 0; cell < boardCells; ++cell, state /= 3) {
+            if (state % 3 == 0) {
+                empty |= 1u << cell;
+            }
+        }
+        return empty;
+    }
+
+    // greedy action of every state, -1 where there is none
+    std::vector<int8_t> bestActions(const DenseQTable &Q, uint32_t &covered) {
+        std::vector<int8_t> actions(stateCount, -1);
+        covered = 0;
+        for (uint32_t state = 0; state < stateCount; ++state) {
+            uint32_t row = state;
+            uint8_t transform = 0;
+            if (Q.isCanonical()) {
+                const auto [slot, frame] = canonicalize(state);
+                row = slot;
+                transform = frame;
+            }
+            const uint32_t legalMoves = transformMask(emptyCellsOf(state), transform);
+            if (legalMoves == 0 || !Q.isVisited(row)) {
+                continue;
+            }
+
+            // lowest cell among the best actions in the row's frame
+            const double *q = Q.row(row);
+            int best = -1;
+            for (uint32_t moves = legalMoves; moves; moves &= moves - 1) {
+                if (const int a = std::countr_zero(moves); best < 0 || q[a] > q[best]) {
+                    best = a;
+                }
+            }
+            actions[state] = static_cast<int8_t>(inverseTransformCell(best, transform));
+            ++covered;
+        }
+        return actions;
+    }
+}
+
+int main(int argc, char **argv) {
+    if (argc != 3) {
+        std::cerr << "usage: " << argv[0] << " <model> <header>\n";
+        return 1;
+    }
+    const std::string input = argv[1], output = argv[2];
+
+    DenseQTable Q;
+    uint64_t episodes = 0;
+    if (isBinaryModel(input)) {
+        MappedModel model;
+        if (!model.open(input)) {
+            return 1;
+        }
+        Q = model.toDenseQTable();
+        episodes = model.episodes();
+    } else {
+        Q.fromQTable(loadQTable(input));
+    }
+    if (Q.size() == 0) {
+        std::cerr << "Error: Q table is empty. Exiting.\n";
+        return 1;
+    }
+
+    uint32_t covered = 0;
+    const auto actions = bestActions(Q, covered);
+
+    std::ofstream out(output, std::ios::trunc);
+    if (!out) {
+        std::cerr << "Error: failed to open " << output << " for writing.\n";
+        return 1;
+    }
+    out << "// Generated by gen_policy from " << input << ", do not edit.\n"
+        << "#ifndef EMBEDDED_POLICY_H\n"
+        << "#define EMBEDDED_POLICY_H\n\n"
+        << "#include <array>\n"
+        << "#include <cstdint>\n\n"
+        << "namespace embedded_policy {\n"
+        << "    // training episodes of the model\n"
+        << "    inline constexpr uint64_t episodes = " << episodes << ";\n"
+        << "    // states with an action\n"
+        << "    inline constexpr uint32_t covered = " << covered << ";\n\n"
+        << "    // greedy cell y * 3 + x of every dense state index (see getStateIndex), -1 for none\n"
+        << "    inline constexpr std::array<int8_t, " << stateCount << "> bestAction = {";
+    for (uint32_t state = 0; state < stateCount; ++state) {
+        out << (state % 32 == 0 ? "\n        " : " ") << static_cast<int>(actions[state]) << ",";
+    }
+    out << "\n    };\n"
+        << "}\n\n"
+        << "#endif //EMBEDDED_POLICY_H\n";
+    out.close();
+    if (!out) {
+        std::cerr << "Error: failed to write " << output << ".\n";
+        return 1;
+    }
+    std::cout << "Wrote the policy of " << covered << " states to " << output << "\n";
+    return 0;
+}
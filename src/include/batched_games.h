@@ -0,0 +1,52 @@
+#ifndef BATCHED_GAMES_H
+#define BATCHED_GAMES_H
+
+#include <cstdint>
+#include <vector>
+#include "qtable.h"
+
+// A batch of 3x3 games (3 in a row) stepped in lockstep, stored as a struct of arrays: game i is
+// element i of every array. Boards are 9-bit stone masks (bit y * 3 + x is cell (x, y)), so placing
+// a stone, the legal move masks and the win check are a few bit operations per game, written
+// without branches so the compiler vectorizes each loop across the whole batch.
+class BatchedGames
+{
+public:
+    // winner() of a game still running, and of a game that ended full without a line
+    static constexpr int8_t running = -1;
+    static constexpr int8_t draw = 2;
+
+private:
+    uint32_t count;
+    std::vector<uint16_t> xStones, oStones;
+    // side to move (0 X, 1 O), moves played, 1 once the game is over, who won
+    std::vector<uint8_t> toMove, plies, done;
+    std::vector<int8_t> winners;
+
+public:
+    explicit BatchedGames(uint32_t count);
+
+    [[nodiscard]] uint32_t size() const { return count; }
+
+    [[nodiscard]] const uint16_t *stones(const int player) const { return player == 0 ? xStones.data() : oStones.data(); }
+    [[nodiscard]] const uint8_t *sideToMove() const { return toMove.data(); }
+    [[nodiscard]] const uint8_t *moveCounts() const { return plies.data(); }
+    [[nodiscard]] const uint8_t *finished() const { return done.data(); }
+    // 0 X won, 1 O won, draw, or running
+    [[nodiscard]] const int8_t *winner() const { return winners.data(); }
+
+    // empty cells of every game, 0 for finished games
+    void legalMasks(uint16_t *masks) const;
+
+    // dense state index (see getStateIndex) of every game
+    void stateIndices(uint32_t *states) const;
+
+    // Every running game places a stone of its side to move on actions[i], which has to be legal,
+    // and then records a win or draw. Finished games ignore their action.
+    void step(const uint8_t *actions);
+
+    // Start every finished game over on an empty board with X to move. Returns how many were reset.
+    uint32_t resetFinished();
+};
+
+#endif //BATCHED_GAMES_H
@@ -0,0 +1,130 @@
+#ifndef BITBOARD_H
+#define BITBOARD_H
+
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <vector>
+
+// A bitset whose length is chosen at runtime.
+// Bit i lives in word i / 64 at position i % 64, bits past the length are always zero.
+class Bitboard
+{
+private:
+    uint64_t length{};
+    std::vector<uint64_t> words;
+
+    // clear the unused high bits of the last word
+    void trim()
+    {
+        if (const auto tail = length % 64; tail != 0 && !words.empty()) {
+            words.back() &= (1ULL << tail) - 1;
+        }
+    }
+
+public:
+    Bitboard() = default;
+    explicit Bitboard(const uint64_t bits) : length(bits), words((bits + 63) / 64, 0) { }
+
+    // change the length and clear every bit
+    void resize(const uint64_t bits)
+    {
+        length = bits;
+        words.assign((bits + 63) / 64, 0);
+    }
+
+    [[nodiscard]] uint64_t size() const { return length; }
+    [[nodiscard]] uint64_t word_count() const { return words.size(); }
+    [[nodiscard]] uint64_t word(const uint64_t i) const { return words[i]; }
+
+    [[nodiscard]] bool test(const uint64_t i) const { return (words[i >> 6] >> (i & 63)) & 1; }
+    void set(const uint64_t i) { words[i >> 6] |= 1ULL << (i & 63); }
+    void reset(const uint64_t i) { words[i >> 6] &= ~(1ULL << (i & 63)); }
+    void clear() { std::ranges::fill(words, 0); }
+
+    [[nodiscard]] bool any() const
+    {
+        for (const auto w : words) {
+            if (w) return true;
+        }
+        return false;
+    }
+
+    [[nodiscard]] uint64_t count() const
+    {
+        uint64_t total = 0;
+        for (const auto w : words) {
+            total += std::popcount(w);
+        }
+        return total;
+    }
+
+    // call f(index) for every set bit, in ascending order
+    template <typename Func>
+    void for_each(Func && f) const
+    {
+        for (uint64_t w = 0; w < words.size(); ++w) {
+            for (uint64_t bits = words[w]; bits; bits &= bits - 1) {
+                f(w * 64 + std::countr_zero(bits));
+            }
+        }
+    }
+
+    Bitboard & operator&=(const Bitboard & other)
+    {
+        for (uint64_t i = 0; i < words.size(); ++i) {
+            words[i] &= other.words[i];
+        }
+        return *this;
+    }
+
+    Bitboard & operator|=(const Bitboard & other)
+    {
+        for (uint64_t i = 0; i < words.size(); ++i) {
+            words[i] |= other.words[i];
+        }
+        return *this;
+    }
+
+    // true if (*this & other) has any bit set, without building the intersection
+    [[nodiscard]] bool intersects(const Bitboard & other) const
+    {
+        for (uint64_t i = 0; i < words.size(); ++i) {
+            if (words[i] & other.words[i]) return true;
+        }
+        return false;
+    }
+
+    // keep bit i only if bit i + n is also set, i.e. *this &= (*this >> n)
+    void and_shifted(const uint64_t n)
+    {
+        const uint64_t skip = n >> 6, offset = n & 63;
+        const uint64_t count = words.size();
+        for (uint64_t i = 0; i < count; ++i) {
+            uint64_t shifted = 0;
+            if (i + skip < count) {
+                shifted = words[i + skip] >> offset;
+                if (offset && i + skip + 1 < count) {
+                    shifted |= words[i + skip + 1] << (64 - offset);
+                }
+            }
+            words[i] &= shifted;
+        }
+    }
+
+    [[nodiscard]] Bitboard operator~() const
+    {
+        Bitboard result = *this;
+        for (auto & w : result.words) {
+            w = ~w;
+        }
+        result.trim();
+        return result;
+    }
+
+    friend Bitboard operator&(Bitboard lhs, const Bitboard & rhs) { return lhs &= rhs; }
+    friend Bitboard operator|(Bitboard lhs, const Bitboard & rhs) { return lhs |= rhs; }
+    friend bool operator==(const Bitboard &, const Bitboard &) = default;
+};
+
+#endif //BITBOARD_H
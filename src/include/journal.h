@@ -0,0 +1,113 @@
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <vector>
+#include "model.h"
+
+// Append-only journal of online Q-updates next to a binary model (see model.h), so a finished
+// game costs a few small appends instead of a rewrite of the whole model.
+//
+// File layout (<model>.journal, native byte order):
+//   JournalHeader
+//   JournalRecord records[]                    in the order the updates were made
+// A record holds the new value of one action, not a delta, so replaying a record twice leaves the
+// same value: a crash while the journal is being folded into the model can always be recovered by
+// replaying every journal that is still there. A record torn by a crash fails its check and is
+// dropped together with everything after it.
+//
+// Compaction folds the journal into the base model in the background: the live journal is renamed
+// to <model>.journal.compacting and a fresh one takes its place, a thread writes a snapshot of the
+// table as the new model, then removes the renamed journal. Startup replays the model, then the
+// compacting journal if a crash left it behind, then the live journal.
+//
+// Every journal names the model it continues by that model's identity (see modelIdentity). A
+// journal of another model, e.g. one left behind when trainer replaced the model, is discarded.
+struct JournalHeader
+{
+    static constexpr char expectedMagic[8] = { 'X', 'O', 'X', 'O', 'J', 'R', 'N', '\0' };
+    static constexpr uint32_t currentVersion = 2;
+
+    char magic[8];
+    uint32_t version;
+    // ModelHeader::canonicalFlag if the states are canonical representatives
+    uint32_t flags;
+    // identity of the model the records continue
+    uint64_t base;
+};
+
+struct JournalRecord
+{
+    // dense state index, a canonical representative in canonical journals (as the keys of a model)
+    uint32_t state;
+    uint16_t action;
+    // mix of the other fields, catches records torn by a crash
+    uint16_t check;
+    double value;
+};
+
+class Journal
+{
+private:
+    std::string path;
+    std::FILE *file = nullptr;
+    bool canonical = false;
+    // records appended since the last flush
+    std::vector<JournalRecord> buffer;
+    // records in the live journal file, flushed or not
+    uint64_t recordCount = 0;
+    std::thread compactor;
+    // set by the compactor thread once the model is written, it still has to be joined
+    std::atomic<bool> compacted{false};
+
+    // what readFile found
+    enum class FileState { missing, complete, damaged, foreign };
+
+    [[nodiscard]] std::string compactingPath() const { return path + ".compacting"; }
+    // write a journal file holding the header and records, through a temporary file renamed into place
+    bool write(const std::string &filename, uint64_t base, const std::vector<JournalRecord> &records) const;
+    // read the model identity and the good records of one journal file
+    FileState readFile(const std::string &filename, uint64_t &base, std::vector<JournalRecord> &records) const;
+    // open the live journal for appending
+    bool reopen();
+
+public:
+    Journal() = default;
+    ~Journal();
+    Journal(const Journal &) = delete;
+    Journal &operator=(const Journal &) = delete;
+
+    // path of the journal of a model file
+    static std::string pathFor(const std::string &modelPath) { return modelPath + ".journal"; }
+    // path of the journal a compaction of a model file folds in
+    static std::string compactingPathFor(const std::string &modelPath) { return pathFor(modelPath) + ".compacting"; }
+
+    // replay every journal of the model mapped from modelPath that is left next to it into the
+    // model's updates, then open the live journal for appending. Returns false (and reports why)
+    // if a journal cannot be used.
+    bool open(const std::string &modelPath, OverlayModel &model, uint64_t *replayed = nullptr);
+
+    // record the new value of an action of a state (a key of the model)
+    void append(uint32_t state, uint32_t action, double value);
+
+    // write the records appended since the last flush in one write
+    bool flush();
+
+    // records in the live journal, what compaction would fold into the model
+    [[nodiscard]] uint64_t records() const { return recordCount; }
+
+    // Fold the journal into the model at modelPath in the background: the model and its updates
+    // are copied into a dense table here, so the caller may keep updating and appending. Returns
+    // false without compacting while an earlier compaction is still running. With wait, returns
+    // once the model has been written.
+    bool compact(const OverlayModel &model, const std::string &modelPath, bool wait = false);
+
+    // wait for a compaction that is still running
+    void waitForCompaction();
+};
+
+#endif //JOURNAL_H
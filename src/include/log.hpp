@@ -2,10 +2,14 @@
 #define LOG_HPP
 
 #include <iostream>
+#include <sstream>
+#include <string>
 #include <mutex>
 #include <map>
 #include <unordered_map>
 #include <atomic>
+#include <cstdint>
+#include <type_traits>
 
 #define construct_simple_type_compare(type)                             \
     template <typename T>                                               \
@@ -15,6 +19,12 @@
     template <typename T>                                               \
     constexpr bool is_##type##_v = is_##type<T>::value;
 
+// Lowest level compiled in (0 debug, 1 info, 2 warning, 3 error). Leveled records below it, such as
+// debug::log<debug::DEBUG>(...) built with -D__LOG_MIN_LEVEL__=1, compile to nothing.
+#ifndef __LOG_MIN_LEVEL__
+# define __LOG_MIN_LEVEL__ 0
+#endif
+
 #ifdef __HARDLINK_LOG__
 # ifndef __LOG_TO_STDOUT__
 #  define LOG_DEV std::cerr
@@ -127,6 +137,30 @@ namespace debug {
         print_container(const Map& map);
 
     extern std::mutex log_mutex;
+
+    // Records are formatted into the log device, or into the calling thread's staging buffer while
+    // it prepares a record for the async writer.
+    inline thread_local std::ostream * format_target = nullptr;
+    inline std::ostream & log_stream() { return format_target ? *format_target : LOG_DEV; }
+
+    // Asynchronous mode: log() formats the record on the calling thread into a thread-local buffer
+    // and pushes it into that thread's lock-free single-producer ring. One background thread drains
+    // every ring and writes the records to the log device in large batches, so callers never take
+    // log_mutex or wait for the device.
+    // A full ring either drops the record (counted, and reported by the writer) or makes the caller
+    // wait for the writer to make room.
+    enum class overflow_policy { drop, block };
+    extern std::atomic < bool > async_log_enabled;
+    // Start the writer thread. Rings are ring_capacity bytes (rounded up to a power of two) and are
+    // created per thread on its first record. It stops on its own at exit.
+    void start_async_log(std::size_t ring_capacity = 1 << 16, overflow_policy policy = overflow_policy::drop);
+    // Write out everything queued, stop the writer and go back to writing directly.
+    void stop_async_log();
+    // records dropped on full rings since the program started
+    std::uint64_t dropped_log_records();
+    // queue a formatted record for the writer, false if async mode has been stopped
+    bool async_log_submit(const std::string & record);
+
     template <typename ParamType>
     void _log(const ParamType& param);
     template <typename ParamType, typename... Args>
@@ -143,49 +177,51 @@ namespace debug {
         , void >
         print_container(const Container& container)
     {
-        LOG_DEV << "[";
+        log_stream() << "[";
         for (auto it = std::begin(container); it != std::end(container); ++it)
         {
             _log(*it);
             if (std::next(it) != std::end(container)) {
-                LOG_DEV << ", ";
+                log_stream() << ", ";
             }
         }
-        LOG_DEV << "]";
+        log_stream() << "]";
     }
 
     template <typename Map>
     std::enable_if_t < debug::is_map_v<Map> || debug::is_unordered_map_v<Map>, void >
         print_container(const Map& map)
     {
-        LOG_DEV << "{";
+        log_stream() << "{";
         for (auto it = std::begin(map); it != std::end(map); ++it)
         {
             _log(it->first);
-            LOG_DEV << ": ";
+            log_stream() << ": ";
             _log(it->second);
             if (std::next(it) != std::end(map)) {
-                LOG_DEV << ", ";
+                log_stream() << ", ";
             }
         }
-        LOG_DEV << "}";
+        log_stream() << "}";
     }
 
-    extern std::string str_true;
-    extern std::string str_false;
+    // bools print as True/False, or as true/false after a lower_case_bool marker
+    extern std::atomic < bool > lower_case_bools;
     enum log_level_t { DEBUG = 0, INFO, WARNING, ERROR };
+    constexpr log_level_t compiled_log_level = static_cast<log_level_t>(__LOG_MIN_LEVEL__);
     extern std::atomic < log_level_t > log_level;
-    extern std::atomic < log_level_t > current_level;
+    // level of the record this thread is writing, set by the level markers
+    extern thread_local log_level_t current_level;
 
     template <typename ParamType> void _log(const ParamType& param)
     {
         auto level_check = [&]()->bool {
-            return current_level >= log_level;
+            return current_level >= log_level.load(std::memory_order_relaxed);
         };
 
         if constexpr (debug::is_string_v<ParamType>) {
             if (level_check()) {
-                LOG_DEV << param;
+                log_stream() << param;
             }
         }
         else if constexpr (debug::is_container_v<ParamType>) {
@@ -195,48 +231,53 @@ namespace debug {
         }
         else if constexpr (debug::is_bool_v<ParamType>) {
             if (level_check()) {
-                LOG_DEV << (param ? str_true : str_false);
+                const bool lower = lower_case_bools.load(std::memory_order_relaxed);
+                log_stream() << (param ? (lower ? "true" : "True") : (lower ? "false" : "False"));
             }
         }
         else if constexpr (debug::is_lower_case_bool_t_v<ParamType>) {
-            str_true = "true";
-            str_false = "false";
+            lower_case_bools.store(true, std::memory_order_relaxed);
         }
         else if constexpr (debug::is_upper_case_bool_t_v<ParamType>) {
-            str_true = "True";
-            str_false = "False";
+            lower_case_bools.store(false, std::memory_order_relaxed);
+        }
+        else if constexpr (std::is_invocable_v<const ParamType &>) {
+            // lazy argument, only evaluated when the record is written
+            if (level_check()) {
+                _log(param());
+            }
         }
         else if constexpr (debug::is_debug_log_t_v<ParamType>) {
             current_level = DEBUG;
 
             if (level_check()) {
-                LOG_DEV << "[DEBUG] ";
+                log_stream() << "[DEBUG] ";
             }
         }
         else if constexpr (debug::is_info_log_t_v<ParamType>) {
             current_level = INFO;
 
             if (level_check()) {
-                LOG_DEV << "[INFO] ";
+                log_stream() << "[INFO] ";
             }
         }
         else if constexpr (debug::is_warning_log_t_v<ParamType>) {
             current_level = WARNING;
 
             if (level_check()) {
-                LOG_DEV << "[WARNING] ";
+                log_stream() << "[WARNING] ";
             }
         }
         else if constexpr (debug::is_error_log_t_v<ParamType>) {
             current_level = ERROR;
 
             if (level_check()) {
-                LOG_DEV << "[ERROR] ";
+                log_stream() << "[ERROR] ";
             }
         }
         else {
             if (level_check()) {
-                LOG_DEV << param;
+                log_stream() << param;
             }
         }
     }
@@ -250,12 +291,51 @@ namespace debug {
 
     template <typename... Args> void log(const Args &...args)
     {
+        if (async_log_enabled.load(std::memory_order_relaxed)) {
+            thread_local std::ostringstream record;
+            record.str(std::string());
+            format_target = &record;
+            debug::_log(args...);
+            format_target = nullptr;
+
+            const auto text = record.str();
+            if (text.empty() || async_log_submit(text)) {
+                return;
+            }
+            // async mode ended while the record was formatted
+            std::lock_guard<std::mutex> lock(log_mutex);
+            LOG_DEV << text << std::flush;
+            return;
+        }
+
         setvbuf(LOG_DEV_FILE, nullptr, _IONBF, 0);
         std::lock_guard<std::mutex> lock(log_mutex);
         debug::_log(args...);
-        LOG_DEV << std::flush;
+        log_stream() << std::flush;
         fflush(LOG_DEV_FILE);
     }
+
+    // marker object that starts a record of the given level
+    template <log_level_t Level> constexpr auto level_marker()
+    {
+        if constexpr (Level == DEBUG) return debug_log;
+        else if constexpr (Level == INFO) return info_log;
+        else if constexpr (Level == WARNING) return warning_log;
+        else return error_log;
+    }
+
+    // A record of a fixed level, e.g. debug::log<debug::DEBUG>(episode, " done\n"). Below
+    // compiled_log_level the call compiles to nothing; otherwise a single relaxed load of log_level
+    // decides before any locking or formatting. Arguments callable without parameters are only
+    // called when the record is written.
+    template <log_level_t Level, typename... Args> void log(const Args &...args)
+    {
+        if constexpr (Level >= compiled_log_level) {
+            if (Level >= log_level.load(std::memory_order_relaxed)) {
+                debug::log(level_marker<Level>(), args...);
+            }
+        }
+    }
 }
 
 #endif // LOG_HPP
@@ -0,0 +1,81 @@
+#ifndef MCTS_H
+#define MCTS_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <vector>
+#include "space.h"
+
+struct MctsConfig
+{
+    // search threads, 0 for one per hardware thread
+    unsigned int threads = 0;
+    // Budget per move: stop after this many playouts or seconds, whichever comes first.
+    // 0 disables a limit, at least one of the two has to be set.
+    uint64_t playouts = 0;
+    double seconds = 1.0;
+    // UCT exploration constant
+    double exploration = 1.4;
+    // nodes in the pool, once it is used up the tree stops growing and leaves keep running playouts
+    uint32_t nodeCapacity = 1u << 20;
+    // seed of the playouts, thread t uses seed + t. 0 seeds from std::random_device.
+    uint64_t seed = 0;
+};
+
+struct MctsResult
+{
+    // best cell y * width + x (the most visited move of the root), -1 if the board is full
+    int move = -1;
+    // mean result of that move for the searching player, 1 win, 0.5 draw, 0 loss
+    double value = 0.0;
+    uint64_t playouts = 0;
+    uint64_t nodes = 0;
+    double seconds = 0.0;
+
+    [[nodiscard]] double playoutsPerSecond() const { return seconds > 0 ? playouts / seconds : 0.0; }
+};
+
+// Tree-parallel Monte-Carlo Tree Search over a Space of any size and win length.
+// All threads grow one shared tree. Nodes come from a fixed pool allocated once, so expansion is a
+// single atomic bump of the pool index and nothing is freed during a search. Statistics are lock
+// free atomics; a thread counts its visit on the way down and adds the result on the way back, so
+// until then the pending visit looks like a loss (virtual loss) and steers the other threads away
+// from the same path.
+class Mcts
+{
+private:
+    struct Node
+    {
+        std::atomic<uint32_t> visits{0};
+        // 2 per win and 1 per draw of the player whose move led to this node
+        std::atomic<uint64_t> score{0};
+        // 0 leaf, 1 being expanded, 2 expanded: children and childCount are set before the release store of 2
+        std::atomic<uint8_t> state{0};
+        uint32_t children = 0;
+        uint32_t childCount = 0;
+        int32_t move = -1;
+    };
+
+    MctsConfig config;
+    std::vector<Node> pool;
+    std::atomic<uint32_t> used{0};
+
+    // index of count fresh nodes, false if the pool has no room
+    bool allocate(uint32_t count, uint32_t &first);
+    void resetNode(uint32_t index, int32_t move);
+    void expand(Node &node, const Space &board);
+    uint32_t select(const Node &node) const;
+    // playouts counts the playouts started by all threads, against config.playouts
+    void worker(const Space &game, signed char player, unsigned int index, std::atomic<uint64_t> &playouts,
+                std::chrono::steady_clock::time_point deadline);
+
+public:
+    explicit Mcts(const MctsConfig &config = {});
+
+    // best move for player (0 for X, 1 for O) on game, searched from scratch within the budget.
+    // Nobody may have won yet.
+    MctsResult search(const Space &game, signed char player);
+};
+
+#endif //MCTS_H
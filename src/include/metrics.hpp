@@ -0,0 +1,94 @@
+#ifndef METRICS_HPP
+#define METRICS_HPP
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Counters, gauges and fixed-bucket histograms, exported in the Prometheus text exposition format.
+//
+// Counters and histograms are sharded per thread: every thread owns a block of value slots and
+// updates its own slot with a relaxed load and store, which compiles to a plain increment. Readers
+// add up the slots of every live thread plus what exited threads left behind. Gauges are single
+// atomics, they are set rather than incremented and are not on hot paths.
+//
+// Metrics are meant to be namespace-scope objects, e.g.
+//     metrics::counter episodes("xoxo_training_episodes_total", "Self-play episodes played");
+//     episodes.inc();
+namespace metrics {
+    // value slots a thread reserves for all counters and histogram buckets together
+    constexpr std::size_t max_slots = 512;
+
+    class counter
+    {
+    private:
+        std::size_t slot;
+
+    public:
+        counter(const std::string & name, const std::string & help);
+        void inc(std::uint64_t n = 1) const;
+        [[nodiscard]] std::uint64_t value() const;
+    };
+
+    class gauge
+    {
+    private:
+        mutable std::atomic < double > current{0.0};
+
+    public:
+        gauge(const std::string & name, const std::string & help);
+        void set(const double value) const { current.store(value, std::memory_order_relaxed); }
+        void add(const double value) const { current.fetch_add(value, std::memory_order_relaxed); }
+        [[nodiscard]] double value() const { return current.load(std::memory_order_relaxed); }
+    };
+
+    class histogram
+    {
+    private:
+        std::vector < double > bounds;
+        // bounds.size() + 1 bucket counts (the last one is +Inf), then the sum of the observations
+        std::size_t first_slot;
+
+    public:
+        // upper bounds of the buckets, ascending
+        histogram(const std::string & name, const std::string & help, std::vector < double > bounds);
+        void observe(double value) const;
+        [[nodiscard]] const std::vector < double > & upper_bounds() const { return bounds; }
+        [[nodiscard]] std::size_t slot() const { return first_slot; }
+    };
+
+    // 100us .. 10s, for phases measured with scoped_timer
+    std::vector < double > latency_buckets();
+
+    // observes the seconds between construction and destruction
+    class scoped_timer
+    {
+    private:
+        const histogram & target;
+        std::chrono::steady_clock::time_point start;
+
+    public:
+        explicit scoped_timer(const histogram & target) : target(target), start(std::chrono::steady_clock::now()) { }
+        ~scoped_timer()
+        {
+            target.observe(std::chrono::duration < double > (std::chrono::steady_clock::now() - start).count());
+        }
+        scoped_timer(const scoped_timer &) = delete;
+        scoped_timer & operator=(const scoped_timer &) = delete;
+    };
+
+    // every metric in the Prometheus text exposition format
+    std::string exposition();
+
+    // write exposition() to a file, replaced atomically so scrapers never read half a snapshot
+    bool write_file(const std::string & path);
+
+    // rewrite the file every interval from a background thread until stop_periodic_dump(),
+    // which writes a last snapshot. Also stopped at exit.
+    void start_periodic_dump(const std::string & path, std::chrono::milliseconds interval);
+    void stop_periodic_dump();
+}
+
+#endif // METRICS_HPP
@@ -0,0 +1,129 @@
+#ifndef MODEL_H
+#define MODEL_H
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "qtable.h"
+
+// Binary model file (ai_model.dat), native byte order:
+//   ModelHeader
+//   uint32_t keys[entryCount]                  dense state indices (see getStateIndex), ascending
+//   double values[entryCount][actions]         Q-values of keys[i] at values[i]
+// Files are written to a temporary name and renamed into place, so readers never see a partial model.
+struct ModelHeader
+{
+    static constexpr char expectedMagic[8] = { 'X', 'O', 'X', 'O', 'Q', 'T', 'B', '\0' };
+    static constexpr uint32_t currentVersion = 1;
+    // keys are canonical representatives (see symmetry.h), actions are in the canonical frame
+    static constexpr uint32_t canonicalFlag = 1;
+
+    char magic[8];
+    uint32_t version;
+    uint32_t flags;
+    uint32_t actions;
+    uint32_t entryCount;
+    // number of training episodes that produced the model
+    uint64_t episodes;
+    // byte offsets of the key and value arrays from the start of the file
+    uint64_t keysOffset;
+    uint64_t valuesOffset;
+};
+
+// Write every visited row of Q as a binary model. Returns false if the file could not be written.
+// A journal left next to the file (see journal.h) holds updates of the model being replaced and is
+// removed, unless keepJournal: compaction writes the very model its journal continues from.
+bool writeModel(const DenseQTable &Q, const std::string &filename, uint64_t episodes = 0, bool keepJournal = false);
+
+// Hash of the episodes and every entry of the model writeModel makes of Q, the same as
+// MappedModel::identity() of that file. Journals record it to tell which model they continue.
+uint64_t modelIdentity(const DenseQTable &Q, uint64_t episodes);
+
+// True if the file starts with the binary model magic.
+bool isBinaryModel(const std::string &filename);
+
+// A binary model mapped into memory. Lookups binary-search the key index in place,
+// nothing is parsed or allocated per entry.
+class MappedModel
+{
+private:
+    std::string path;
+    unsigned char *base = nullptr;
+    uint64_t length = 0;
+    bool writable = false;
+    // platforms without mmap read the file into this buffer instead
+    std::vector<unsigned char> fallback;
+
+    const ModelHeader *header = nullptr;
+    const uint32_t *keys = nullptr;
+    double *values = nullptr;
+
+    void close();
+
+public:
+    MappedModel() = default;
+    ~MappedModel();
+    MappedModel(const MappedModel &) = delete;
+    MappedModel &operator=(const MappedModel &) = delete;
+    MappedModel(MappedModel &&other) noexcept;
+    MappedModel &operator=(MappedModel &&other) noexcept;
+
+    // map a model file, writable maps are shared with the file so in-place updates reach the disk.
+    // Returns false (and reports why) if the file is missing or not a valid model.
+    bool open(const std::string &filename, bool writable = false);
+
+    [[nodiscard]] bool isOpen() const { return header != nullptr; }
+    [[nodiscard]] bool isCanonical() const { return header->flags & ModelHeader::canonicalFlag; }
+    [[nodiscard]] uint32_t size() const { return header->entryCount; }
+    [[nodiscard]] uint64_t episodes() const { return header->episodes; }
+    [[nodiscard]] uint32_t keyAt(const uint32_t i) const { return keys[i]; }
+    [[nodiscard]] const double *valuesAt(const uint32_t i) const { return values + static_cast<uint64_t>(i) * boardCells; }
+
+    // Q-values of a state, or nullptr if the model has no entry for it
+    [[nodiscard]] const double *find(uint32_t state) const;
+    // same as find, for in-place updates of a writable model
+    [[nodiscard]] double *findMutable(uint32_t state);
+
+    // hash of the episodes and every entry, see modelIdentity
+    [[nodiscard]] uint64_t identity() const;
+
+    // flush in-place updates of a writable model to disk
+    void sync();
+
+    // copy every entry into a dense table (built canonical if the model is)
+    [[nodiscard]] DenseQTable toDenseQTable() const;
+};
+
+// A mapped model with the updates made since it was written layered on top (see journal.h), for
+// programs that keep learning from a model: lookups read an updated row if there is one and the
+// mapping in place otherwise, so only rows that changed are ever copied. States are keys of the
+// model, canonical representatives in canonical models (see MappedModel).
+class OverlayModel
+{
+private:
+    MappedModel model;
+    // Q-values of every state updated since the model was written
+    std::unordered_map<uint32_t, std::array<double, boardCells>> updates;
+
+public:
+    // map a model file, see MappedModel::open
+    bool open(const std::string &filename) { updates.clear(); return model.open(filename); }
+
+    [[nodiscard]] const MappedModel &base() const { return model; }
+    [[nodiscard]] bool isCanonical() const { return model.isCanonical(); }
+    [[nodiscard]] uint64_t updatedStates() const { return updates.size(); }
+
+    // Q-values of a state, or nullptr if neither the updates nor the model have it
+    [[nodiscard]] const double *find(uint32_t state) const;
+
+    // Q-values of a state to update, copied from the model on first use (zeros for a state the
+    // model lacks)
+    [[nodiscard]] double *update(uint32_t state);
+
+    // the model with every update applied, as a dense table (canonical if the model is)
+    [[nodiscard]] DenseQTable toDenseQTable() const;
+};
+
+#endif //MODEL_H
@@ -0,0 +1,125 @@
+#ifndef MOVE_SERVER_H
+#define MOVE_SERVER_H
+
+#include <array>
+#include <cstdint>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "journal.h"
+#include "model.h"
+#include "static_space.h"
+
+struct ServerConfig
+{
+    // Q-learning hyperparameters of the online updates after every game
+    double alpha = 0.1;
+    double discount = 0.9;  // gamma, named so it does not clash with ::gamma() from <cmath>
+    // seed of the random moves on boards the model has never seen. 0 seeds from std::random_device.
+    uint64_t seed = 0;
+    // open sessions one client may hold, further "new" requests are refused
+    uint32_t maxSessionsPerClient = 65536;
+};
+
+// One request line from a client and the line to send back, see MoveServer for the protocol.
+struct ServerRequest
+{
+    uint32_t client = 0;
+    std::string line;
+    std::string reply;
+};
+
+// Serves many 3x3 games against a model at once, the model is shared by every session and
+// learns from each finished game in its updates (see OverlayModel), so later games of any session
+// play with what earlier games taught it.
+//
+// Line protocol, one reply line per request:
+//   new [x|o]            start a game where the client plays x (default) or o
+//                        -> ok <id>                 the client moves first
+//                        -> ok <id> <x> <y>         the AI, playing x, opened at (x, y)
+//   move <id> <x> <y>    the client's stone at (x, y)
+//                        -> ai <id> <x> <y> <r>     the AI's answer, r is - while the game goes on,
+//                                                   x or o when that side won, draw for a draw
+//                        -> end <id> <r>            the client's move ended the game
+//   close <id>           abandon a game, nothing is learned from it -> ok <id>
+//   stats                -> stats sessions=<n> games=<n> moves=<n>
+// A finished game ends its session. Malformed or illegal requests get "error <message>", as does
+// "new" from a client that already holds config.maxSessionsPerClient sessions.
+//
+// handle() takes every request that arrived since the last call. Client moves are applied in
+// order, and the AI moves they call for are collected and chosen together in one pass over the
+// table, so a burst of requests from thousands of sessions costs one batch rather than one round
+// trip each.
+class MoveServer
+{
+private:
+    struct Session
+    {
+        Board3x3 board;
+        uint32_t client = 0;
+        // the AI's stone, 0 for X and 1 for O
+        signed char ai = 1;
+        // (state of the model, action in the state's frame) of every AI move, learned from once the game ends
+        std::array<std::pair<uint32_t, uint8_t>, (boardCells + 1) / 2> history{};
+        uint8_t aiMoves = 0;
+        // an AI move is queued in the current batch
+        bool pending = false;
+    };
+
+    struct PendingMove
+    {
+        ServerRequest *request;
+        uint64_t id;
+        // reply prefix, e.g. "ai 12"
+        std::string prefix;
+        // whether the reply ends with the game result
+        bool withResult;
+    };
+
+    OverlayModel &model;
+    ServerConfig config;
+    // receives every online update, flushed once per batch
+    Journal *journal;
+    std::mt19937_64 gen;
+
+    // node-based, so sessions keep their address while others come and go
+    std::unordered_map<uint64_t, Session> sessions;
+    // open sessions of every client that has any
+    std::unordered_map<uint32_t, uint32_t> clientSessions;
+    uint64_t nextId = 1;
+    uint64_t gameCount = 0;
+    uint64_t moveCount = 0;
+
+    std::vector<PendingMove> pending;
+
+    // handle one request, appending its AI move to pending if it needs one
+    void dispatch(ServerRequest &request);
+    // choose every pending AI move, then reply and learn
+    void flush();
+    // update the model from the AI moves of a finished game, reward is from the AI's point of view
+    void learn(const Session &session, double reward);
+    // result letter after a move, learns and ends the session when the game is over
+    std::string finishIfOver(uint64_t id, Session &session, int cell);
+    // forget a session
+    void endSession(std::unordered_map<uint64_t, Session>::iterator it);
+
+public:
+    // updates are recorded in journal unless it is null
+    MoveServer(OverlayModel &model, const ServerConfig &config, Journal *journal = nullptr);
+
+    // serve a batch of requests, filling in every reply
+    void handle(std::vector<ServerRequest> &batch);
+
+    // abandon every session of a client that went away
+    void dropClient(uint32_t client);
+
+    [[nodiscard]] uint64_t sessionCount() const { return sessions.size(); }
+    // games finished and learned from
+    [[nodiscard]] uint64_t games() const { return gameCount; }
+    // AI moves played
+    [[nodiscard]] uint64_t moves() const { return moveCount; }
+};
+
+#endif //MOVE_SERVER_H
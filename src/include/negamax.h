@@ -0,0 +1,76 @@
+#ifndef NEGAMAX_H
+#define NEGAMAX_H
+
+#include <cstdint>
+#include <vector>
+#include "space.h"
+#include "qtable.h"
+
+// Exact game-theoretic solver for k-in-a-row on a Space: negamax with alpha-beta pruning, a
+// transposition table keyed by the board's Zobrist hash and move ordering (immediate wins, then
+// the table's best move, then cells on the most potential lines). The search plays on the board it was given with
+// make_move / unmake_move, so no board is ever copied, and leaves it as it found it.
+//
+// Scores are from the point of view of the player to move: 0 is a draw, a win scores the number of
+// empty cells before the winning move and a loss the negative of that, so faster wins and slower
+// losses score higher. A score only depends on the board, which lets the table share it between
+// every move order that reaches the board.
+class Solver
+{
+private:
+    enum class Bound : uint8_t { none, exact, lower, upper };
+
+    struct Entry
+    {
+        uint64_t key = 0;
+        int32_t move = -1;
+        int16_t score = 0;
+        Bound bound = Bound::none;
+    };
+
+    Space &game;
+    uint64_t width, cells;
+    // cells sorted by the number of winning lines through them, most first
+    std::vector<int> cellOrder;
+
+    std::vector<Entry> table;
+    uint64_t tableMask;
+
+    int empties = 0;
+    uint64_t nodeCount = 0;
+
+    void play(int cell, signed char player);
+    void undo(int cell, signed char player);
+    [[nodiscard]] bool wins(int cell, signed char player);
+    int negamax(signed char player, int alpha, int beta);
+    // table key of the board with player to move: the board's own hash (see Space::hash), flipped for O
+    [[nodiscard]] uint64_t key(signed char player) const;
+    void countEmpties();
+
+public:
+    // solve positions of game, the transposition table has 2^tableBits entries
+    explicit Solver(Space &game, unsigned int tableBits = 20);
+
+    // value of the current position with player (0 for X, 1 for O) to move. Nobody may have won yet.
+    int solve(signed char player);
+
+    // value, for player, of player putting a stone on the empty cell y * width + x
+    int solveMove(int cell, signed char player);
+
+    // empty cell with the best value for player, -1 if the board is full
+    int bestMove(signed char player);
+
+    // positions searched since construction
+    [[nodiscard]] uint64_t nodes() const { return nodeCount; }
+
+    // forget every stored result, needed after changing the board size or win length of game
+    void clear();
+};
+
+// Q-table of perfect play on the 3x3 board with 3 in a row: every legal action of every reachable,
+// undecided state holds its exact value scaled into (-1, 1) (score / (boardCells + 1)), so the
+// greedy policy of the table never loses and wins as fast as possible. nodes receives the number
+// of positions searched.
+DenseQTable solvedQTable(bool canonical, uint64_t *nodes = nullptr);
+
+#endif //NEGAMAX_H
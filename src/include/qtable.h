@@ -0,0 +1,133 @@
+#ifndef QTABLE_H
+#define QTABLE_H
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "space.h"
+
+// Sparse Q-table as stored in ai_model.dat:
+// Key: string encoding of the board + current player
+// Value: vector of Q-values for each of the 9 possible cell positions.
+using QTable = std::unordered_map<std::string, std::vector<double>>;
+
+// Number of cells (and therefore actions) of the 3x3 board.
+constexpr uint32_t boardCells = 9;
+// 3^9 boards, each cell empty, X or O.
+constexpr uint32_t boardCount = 19683;
+// Every board with either player to move.
+constexpr uint32_t stateCount = boardCount * 2;
+
+// Dense index of a 3x3 board and the player to move ('X' or 'O').
+// Cell i contributes its base-3 digit (0 empty, 1 X, 2 O) times 3^i, the whole number is
+// doubled and the side to move (0 for X, 1 for O) is added as the lowest bit.
+uint32_t getStateIndex(const Space &game, char currentPlayer);
+// same from the 9-bit stone masks of X and O (bit y * 3 + x is cell (x, y))
+uint32_t getStateIndex(uint32_t xStones, uint32_t oStones, char currentPlayer);
+
+// Get a string key for the current board state and player turn.
+// The board is encoded row by row as:
+// '-' for empty, 'X' for cell with 0, and 'O' for cell with 1.
+// Then we append the current player's identifier.
+std::string getStateKey(const Space &game, char currentPlayer);
+
+// Convert between the dense index and the string key. parseStateKey returns false for malformed keys.
+std::string stateKeyOf(uint32_t state);
+bool parseStateKey(const std::string &key, uint32_t &state);
+
+// Bit mask of the empty cells of a 3x3 board, bit y * 3 + x is cell (x, y).
+uint32_t getLegalMoveMask(const Space &game);
+
+// Return the list of legal moves (cell indices) from the current state.
+std::vector<int> getLegalMoves(const Space &game);
+
+// Q-table for the 3x3 board stored as one contiguous double[rows][boardCells] array indexed
+// directly, so lookups need no hashing or allocation. Rows are dense state indices (see
+// getStateIndex), or canonical slots (see symmetry.h) when the table is built canonical, which
+// stores one row per group of symmetric boards. Rows that were never touched are not written out
+// by toQTable().
+class DenseQTable
+{
+private:
+    bool canonical;
+    uint32_t rows;
+    std::vector<double> values;
+    std::vector<uint8_t> visited;
+    uint64_t visitedCount = 0;
+
+public:
+    explicit DenseQTable(bool canonical = false);
+
+    // Q-values of every action in a row, marks the row as visited
+    double *row(const uint32_t index)
+    {
+        if (!visited[index]) {
+            visited[index] = 1;
+            ++visitedCount;
+        }
+        return values.data() + static_cast<uint64_t>(index) * boardCells;
+    }
+
+    [[nodiscard]] const double *row(const uint32_t index) const
+    {
+        return values.data() + static_cast<uint64_t>(index) * boardCells;
+    }
+
+    // Hogwild access for a table shared between threads: values and visited flags are read and
+    // written with relaxed atomics, so no lock is taken and updates can be lost but never torn.
+    [[nodiscard]] double loadShared(const uint32_t index, const uint32_t action) const
+    {
+        auto &value = const_cast<double &>(values[static_cast<uint64_t>(index) * boardCells + action]);
+        return std::atomic_ref(value).load(std::memory_order_relaxed);
+    }
+
+    void storeShared(const uint32_t index, const uint32_t action, const double value)
+    {
+        std::atomic_ref(values[static_cast<uint64_t>(index) * boardCells + action]).store(value, std::memory_order_relaxed);
+    }
+
+    // mark a row visited, true if this call was the first to visit it
+    bool visitShared(const uint32_t index)
+    {
+        if (std::atomic_ref flag(visited[index]); !flag.load(std::memory_order_relaxed)
+            && !flag.exchange(1, std::memory_order_relaxed)) {
+            std::atomic_ref(visitedCount).fetch_add(1, std::memory_order_relaxed);
+            return true;
+        }
+        return false;
+    }
+
+    // copy of a table that other threads keep updating through the shared accessors, every value
+    // is read atomically but the copy as a whole is not taken at a single point in time
+    [[nodiscard]] DenseQTable sharedSnapshot() const;
+
+    [[nodiscard]] bool isVisited(const uint32_t index) const { return visited[index]; }
+    [[nodiscard]] bool isCanonical() const { return canonical; }
+    [[nodiscard]] uint32_t rowCount() const { return rows; }
+
+    // number of visited rows
+    [[nodiscard]] uint64_t size() const { return visitedCount; }
+
+    // memory of the values and visited flags of every row
+    [[nodiscard]] uint64_t bytes() const { return static_cast<uint64_t>(rows) * (boardCells * sizeof(double) + sizeof(uint8_t)); }
+
+    // string key (as in ai_model.dat) of the state a row stands for
+    [[nodiscard]] std::string keyOf(uint32_t index) const;
+
+    // sparse copy of every visited row, keyed like ai_model.dat
+    [[nodiscard]] QTable toQTable() const;
+
+    // load every well-formed entry of a sparse table, a canonical table rotates
+    // entries of non-canonical boards into their canonical frame
+    void fromQTable(const QTable &Q);
+};
+
+// Loads the Q-table from a file.
+QTable loadQTable(const std::string &filename);
+
+// Saves the Q-table to a file. Returns false if the file could not be written.
+bool saveQTable(const QTable &Q, const std::string &filename);
+
+#endif //QTABLE_H
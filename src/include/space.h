@@ -1,31 +1,141 @@
 #ifndef SPACE_H
 #define SPACE_H
 
-#include <vector>
+#include <cstdint>
+#include <stdexcept>
+#include "bitboard.h"
 
 class Space
 {
 private:
     uint64_t width{}, height{};
-    std::vector<std::vector<signed char>> desk;
-    signed win_within_3x3(int x, int y);
+
+    // one occupancy bitset per player, rows are packed next to each other so cell (x, y) is bit y * width + x
+    Bitboard stones_of[2];
+
+    // number of aligned stones needed to win
+    uint64_t win_length = 3;
+
+    // Zobrist hash of the stones, the xor of zobrist_key over every stone on the board
+    uint64_t zobrist_hash = 0;
+
+    // line directions as {dx, dy}: horizontal, vertical, diagonal, anti-diagonal.
+    // line_shift is the bit distance between two neighbours along the direction,
+    // line_starts marks every cell a full line of win_length can start from in that direction
+    static constexpr int line_direction[4][2] = { {1, 0}, {0, 1}, {1, 1}, {-1, 1} };
+    uint64_t line_shift[4]{};
+    Bitboard line_starts[4];
+    void build_line_masks();
+
+    [[nodiscard]] uint64_t index_of(const int x, const int y) const { return y * width + x; }
+    [[nodiscard]] bool in_range(const int x, const int y) const { return x >= 0 && static_cast<uint64_t>(x) < width && y >= 0 && static_cast<uint64_t>(y) < height; }
+    [[nodiscard]] bool has_line(const Bitboard & board) const;
 
 public:
     // resize table to a new size (only larger table size is accepted)
     void resize(int new_width, int new_height);
     Space();
 
-    // place an object in the map. 0 for X and 1 for O
+    // a new, empty table of the given size where win_length stones in a row win (e.g. 15, 15, 5 for Gomoku)
+    Space(int new_width, int new_height, int new_win_length = 3);
+
+    // change the number of aligned stones needed to win
+    void set_win_length(int new_win_length);
+
+    // place an object in the map. 0 for X and 1 for O, -1 clears the cell
     void place(int x, int y, signed char c);
 
     // get the specific object, 0 for X, 1 for O, and -1 for empty
     [[nodiscard]] signed char get(int x, int y) const;
 
+    // empty every cell, keeping the size and win length
+    void clear()
+    {
+        stones_of[0].clear();
+        stones_of[1].clear();
+        zobrist_hash = 0;
+    }
+
+    // put a stone of player c (0 for X, 1 for O) on an empty cell and take it back again.
+    // For search loops: no range or occupancy checks, the caller guarantees the cell is empty
+    // before make_move and holds c's stone before unmake_move.
+    void make_move(const int x, const int y, const signed char c)
+    {
+        stones_of[c].set(index_of(x, y));
+        zobrist_hash ^= zobrist_key(x, y, c);
+    }
+    void unmake_move(const int x, const int y, const signed char c)
+    {
+        stones_of[c].reset(index_of(x, y));
+        zobrist_hash ^= zobrist_key(x, y, c);
+    }
+
+    // 64-bit hash of the stones on the board, kept up to date by every placement and removal.
+    // Equal boards hash equally whatever their move order; the side to move is not included.
+    [[nodiscard]] uint64_t hash() const { return zobrist_hash; }
+
+    // Zobrist key of a stone of player c at (x, y). It is a mix of the coordinates rather than a
+    // table entry, so it needs no storage and a stone keeps its key when the board is resized.
+    [[nodiscard]] static uint64_t zobrist_key(const int x, const int y, const signed char c)
+    {
+        // splitmix64 finalizer of the packed coordinates
+        uint64_t z = (static_cast<uint64_t>(static_cast<uint32_t>(x)) << 32 | static_cast<uint32_t>(y) << 1 | c)
+            + 0x9e3779b97f4a7c15ULL;
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+        return z ^ (z >> 31);
+    }
+
     // print out current table
     void print() const;
 
     // check if anyone is winning. 0 for X winning, 1 for O winning, -1 for none.
-    signed check_win();
+    [[nodiscard]] signed check_win() const;
+
+    // check only the lines through (x, y), the cell that was just placed. Same result as check_win()
+    // as long as nobody had won before that move, but costs O(win length) instead of O(width * height).
+    [[nodiscard]] signed check_win(int x, int y) const;
+
+    [[nodiscard]] uint64_t get_width() const { return width; }
+    [[nodiscard]] uint64_t get_height() const { return height; }
+    [[nodiscard]] uint64_t get_win_length() const { return win_length; }
+
+    // occupancy of one player (0 for X, 1 for O), cell (x, y) is bit y * width + x
+    [[nodiscard]] const Bitboard & stones(const signed char c) const { return stones_of[c]; }
+
+    // every empty cell, cell (x, y) is bit y * width + x
+    [[nodiscard]] Bitboard empty_cells() const { return ~(stones_of[0] | stones_of[1]); }
 };
 
+inline void Space::place(const int x, const int y, const signed char c)
+{
+    if (!in_range(x, y)) {
+        throw std::out_of_range("Placement out of range");
+    }
+
+    const auto index = index_of(x, y);
+    for (signed char player = 0; player < 2; ++player) {
+        if (stones_of[player].test(index)) {
+            stones_of[player].reset(index);
+            zobrist_hash ^= zobrist_key(x, y, player);
+        }
+    }
+    if (c == 0 || c == 1) {
+        stones_of[c].set(index);
+        zobrist_hash ^= zobrist_key(x, y, c);
+    }
+}
+
+inline signed char Space::get(const int x, const int y) const
+{
+    if (!in_range(x, y)) {
+        throw std::out_of_range("Index out of range");
+    }
+
+    const auto index = index_of(x, y);
+    if (stones_of[0].test(index)) return 0;
+    if (stones_of[1].test(index)) return 1;
+    return -1;
+}
+
 #endif //SPACE_H
@@ -0,0 +1,120 @@
+#ifndef SPARSE_SPACE_H
+#define SPARSE_SPACE_H
+
+#include <bit>
+#include <cstdint>
+#include <unordered_map>
+#include "space.h"
+
+// An unbounded board for open-ended games, where play may drift in any direction including
+// negative coordinates. Only occupied regions are stored: the plane is cut into 8x8 chunks, each
+// holding one 64-bit occupancy mask per player, kept in a hash map keyed by chunk coordinate.
+// Placing a stone far away adds one chunk and never moves existing cells, so memory follows the
+// number of stones rather than their bounding box.
+//
+// Inside a chunk cell (x, y) is bit (y & 7) * 8 + (x & 7); the chunk of (x, y) is (x >> 3, y >> 3),
+// which rounds toward negative infinity so negative coordinates need no special case.
+class SparseSpace
+{
+public:
+    static constexpr int chunk_bits = 3;
+    static constexpr int chunk_size = 1 << chunk_bits;
+
+    // smallest rectangle holding every stone, inclusive. Empty when there are no stones.
+    struct Bounds
+    {
+        int min_x = 0, min_y = 0, max_x = -1, max_y = -1;
+        [[nodiscard]] bool empty() const { return max_x < min_x; }
+    };
+
+private:
+    struct Chunk
+    {
+        uint64_t stones_of[2]{};
+        [[nodiscard]] bool empty() const { return (stones_of[0] | stones_of[1]) == 0; }
+    };
+
+    std::unordered_map<uint64_t, Chunk> chunks;
+
+    // number of aligned stones needed to win
+    uint64_t win_length;
+
+    uint64_t zobrist_hash = 0;
+    uint64_t stone_total = 0;
+
+    static constexpr int line_direction[4][2] = { {1, 0}, {0, 1}, {1, 1}, {-1, 1} };
+
+    [[nodiscard]] static uint64_t chunk_key(const int cx, const int cy)
+    {
+        return static_cast<uint64_t>(static_cast<uint32_t>(cx)) << 32 | static_cast<uint32_t>(cy);
+    }
+    [[nodiscard]] static uint64_t bit_of(const int x, const int y)
+    {
+        return 1ULL << (((y & (chunk_size - 1)) << chunk_bits) | (x & (chunk_size - 1)));
+    }
+
+    [[nodiscard]] const Chunk * find_chunk(int x, int y) const;
+
+    // stones of player c in a row from (x, y) stepping by (dx, dy), not counting (x, y), at most limit
+    [[nodiscard]] uint64_t run_length(int x, int y, int dx, int dy, signed char c, uint64_t limit) const;
+
+public:
+    // an empty board where win_length stones in a row win (5 for Gomoku)
+    explicit SparseSpace(int new_win_length = 5);
+
+    // change the number of aligned stones needed to win
+    void set_win_length(int new_win_length);
+
+    // place an object in the map. 0 for X and 1 for O, -1 clears the cell. Any coordinates are valid.
+    void place(int x, int y, signed char c);
+
+    // get the specific object, 0 for X, 1 for O, and -1 for empty
+    [[nodiscard]] signed char get(int x, int y) const;
+
+    // put a stone of player c (0 for X, 1 for O) on an empty cell and take it back again, without
+    // the checks of place. unmake_move keeps a chunk it empties, so a search that keeps returning
+    // to the same region does not free and reallocate it; place(x, y, -1) releases empty chunks.
+    void make_move(int x, int y, signed char c);
+    void unmake_move(int x, int y, signed char c);
+
+    // Zobrist hash of the stones, with the same keys as Space (Space::zobrist_key), so a position
+    // hashes the same on either board.
+    [[nodiscard]] uint64_t hash() const { return zobrist_hash; }
+
+    // check if anyone is winning. 0 for X winning, 1 for O winning, -1 for none. Visits every stone.
+    [[nodiscard]] signed check_win() const;
+
+    // check only the lines through (x, y), the cell that was just placed, across chunk borders.
+    // Same result as check_win() as long as nobody had won before that move.
+    [[nodiscard]] signed check_win(int x, int y) const;
+
+    // call f(x, y, c) for every stone, in no particular order
+    template <typename Func>
+    void for_each_stone(Func && f) const;
+
+    [[nodiscard]] Bounds bounds() const;
+
+    // print the bounding box of the stones
+    void print() const;
+
+    [[nodiscard]] uint64_t get_win_length() const { return win_length; }
+    [[nodiscard]] uint64_t stone_count() const { return stone_total; }
+    [[nodiscard]] uint64_t chunk_count() const { return chunks.size(); }
+};
+
+template <typename Func>
+void SparseSpace::for_each_stone(Func && f) const
+{
+    for (const auto & [key, chunk] : chunks) {
+        const int base_x = static_cast<int32_t>(static_cast<uint32_t>(key >> 32)) * chunk_size;
+        const int base_y = static_cast<int32_t>(static_cast<uint32_t>(key)) * chunk_size;
+        for (signed char player = 0; player < 2; ++player) {
+            for (uint64_t bits = chunk.stones_of[player]; bits; bits &= bits - 1) {
+                const int bit = std::countr_zero(bits);
+                f(base_x + (bit & (chunk_size - 1)), base_y + (bit >> chunk_bits), player);
+            }
+        }
+    }
+}
+
+#endif //SPARSE_SPACE_H
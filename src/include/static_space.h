@@ -0,0 +1,211 @@
+#ifndef STATIC_SPACE_H
+#define STATIC_SPACE_H
+
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <stdexcept>
+#include <utility>
+
+// A board whose width, height and win length are compile-time constants, for hot loops on a fixed
+// size such as the 3x3 board of the trainer. Space stays the board for sizes only known at runtime.
+//
+// Each player's stones are one 64-bit mask, cell (x, y) is bit y * W + x as in Space. Every line
+// of K cells is a constexpr mask, and a win check is an unrolled and/compare over the masks, so
+// StaticSpace<3, 3, 3>::check_win(cell) is at most four ands and compares.
+template <int W, int H, int K>
+class StaticSpace
+{
+    static_assert(W >= 1 && H >= 1 && W * H <= 64, "a StaticSpace must fit in 64 cells");
+    static_assert(K >= 1 && (K <= W || K <= H), "a line of win length must fit on the board");
+
+public:
+    static constexpr int width = W;
+    static constexpr int height = H;
+    static constexpr int win_length = K;
+    static constexpr int cells = W * H;
+    static constexpr uint64_t full_mask = cells == 64 ? ~0ULL : (1ULL << cells) - 1;
+
+private:
+    static constexpr int line_direction[4][2] = { {1, 0}, {0, 1}, {1, 1}, {-1, 1} };
+
+    // call f(mask) for every line of K cells on the board
+    template <typename Func>
+    static constexpr void for_each_line(Func && f)
+    {
+        for (const auto & [dx, dy] : line_direction) {
+            for (int y = 0; y < H; ++y) {
+                for (int x = 0; x < W; ++x) {
+                    const int end_x = x + dx * (K - 1), end_y = y + dy * (K - 1);
+                    if (end_x < 0 || end_x >= W || end_y >= H) {
+                        continue;
+                    }
+                    uint64_t mask = 0;
+                    for (int step = 0; step < K; ++step) {
+                        mask |= 1ULL << ((y + dy * step) * W + x + dx * step);
+                    }
+                    f(mask);
+                }
+            }
+        }
+    }
+
+    static constexpr std::size_t count_lines()
+    {
+        std::size_t count = 0;
+        for_each_line([&](uint64_t) { ++count; });
+        return count;
+    }
+
+    // most lines any single cell lies on
+    static constexpr std::size_t count_lines_per_cell()
+    {
+        std::array<std::size_t, cells> through{};
+        for_each_line([&](const uint64_t mask) {
+            for (int cell = 0; cell < cells; ++cell) {
+                through[cell] += (mask >> cell) & 1;
+            }
+        });
+        std::size_t most = 0;
+        for (const auto count : through) {
+            most = count > most ? count : most;
+        }
+        return most;
+    }
+
+public:
+    static constexpr std::size_t line_count = count_lines();
+    static constexpr std::size_t lines_per_cell = count_lines_per_cell();
+
+    // every line of K cells
+    static constexpr std::array<uint64_t, line_count> lines = [] {
+        std::array<uint64_t, line_count> table{};
+        std::size_t next = 0;
+        for_each_line([&](const uint64_t mask) { table[next++] = mask; });
+        return table;
+    }();
+
+    // lines through each cell. A cell on fewer than lines_per_cell lines repeats its first line, so
+    // every row has the same length and a check can unroll over it without a count.
+    static constexpr std::array<std::array<uint64_t, lines_per_cell>, cells> lines_through = [] {
+        std::array<std::array<uint64_t, lines_per_cell>, cells> table{};
+        for (int cell = 0; cell < cells; ++cell) {
+            std::size_t next = 0;
+            for (const auto mask : lines) {
+                if ((mask >> cell) & 1) {
+                    table[cell][next++] = mask;
+                }
+            }
+            // a horizontal or vertical line passes through every cell
+            for (std::size_t fill = next; fill < lines_per_cell; ++fill) {
+                table[cell][fill] = table[cell][0];
+            }
+        }
+        return table;
+    }();
+
+private:
+    uint64_t stones_of[2]{};
+
+    template <std::size_t N, std::size_t... I>
+    static constexpr bool has_line(const uint64_t stones, const std::array<uint64_t, N> & masks,
+                                   std::index_sequence<I...>)
+    {
+        return (((stones & masks[I]) == masks[I]) | ...);
+    }
+
+    template <std::size_t N>
+    static constexpr bool has_line(const uint64_t stones, const std::array<uint64_t, N> & masks)
+    {
+        return has_line(stones, masks, std::make_index_sequence<N>{});
+    }
+
+    static constexpr bool in_range(const int x, const int y) { return x >= 0 && x < W && y >= 0 && y < H; }
+
+public:
+    constexpr StaticSpace() = default;
+
+    [[nodiscard]] static constexpr int index_of(const int x, const int y) { return y * W + x; }
+
+    // place an object in the map. 0 for X and 1 for O, -1 clears the cell
+    constexpr void place(const int x, const int y, const signed char c)
+    {
+        if (!in_range(x, y)) {
+            throw std::out_of_range("Placement out of range");
+        }
+        const uint64_t bit = 1ULL << index_of(x, y);
+        stones_of[0] &= ~bit;
+        stones_of[1] &= ~bit;
+        if (c == 0 || c == 1) {
+            stones_of[c] |= bit;
+        }
+    }
+
+    // get the specific object, 0 for X, 1 for O, and -1 for empty
+    [[nodiscard]] constexpr signed char get(const int x, const int y) const
+    {
+        if (!in_range(x, y)) {
+            throw std::out_of_range("Index out of range");
+        }
+        return at(index_of(x, y));
+    }
+
+    // Unchecked access by cell index (y * W + x) for internal loops: the caller guarantees the cell
+    // is on the board, that it is empty before make_move and that it holds c's stone before unmake_move.
+    [[nodiscard]] constexpr signed char at(const int cell) const
+    {
+        if ((stones_of[0] >> cell) & 1) return 0;
+        if ((stones_of[1] >> cell) & 1) return 1;
+        return -1;
+    }
+    constexpr void make_move(const int cell, const signed char c) { stones_of[c] |= 1ULL << cell; }
+    constexpr void unmake_move(const int cell, const signed char c) { stones_of[c] &= ~(1ULL << cell); }
+
+    // empty every cell
+    constexpr void clear()
+    {
+        stones_of[0] = 0;
+        stones_of[1] = 0;
+    }
+
+    // check if anyone is winning. 0 for X winning, 1 for O winning, -1 for none.
+    [[nodiscard]] constexpr signed check_win() const
+    {
+        if (has_line(stones_of[0], lines)) return 0;
+        if (has_line(stones_of[1], lines)) return 1;
+        return -1;
+    }
+
+    // check only the lines through cell, the one that was just placed. Same result as check_win()
+    // as long as nobody had won before that move.
+    [[nodiscard]] constexpr signed check_win(const int cell) const
+    {
+        const signed char c = at(cell);
+        if (c == -1) {
+            return -1;
+        }
+        return has_line(stones_of[c], lines_through[cell]) ? c : -1;
+    }
+
+    // whether player c has a line through cell, when c is known to own it
+    [[nodiscard]] constexpr bool wins(const int cell, const signed char c) const
+    {
+        return has_line(stones_of[c], lines_through[cell]);
+    }
+
+    // occupancy of one player (0 for X, 1 for O), cell (x, y) is bit y * W + x
+    [[nodiscard]] constexpr uint64_t stones(const signed char c) const { return stones_of[c]; }
+
+    // every empty cell, cell (x, y) is bit y * W + x
+    [[nodiscard]] constexpr uint64_t empty_cells() const { return ~(stones_of[0] | stones_of[1]) & full_mask; }
+
+    [[nodiscard]] constexpr bool full() const { return empty_cells() == 0; }
+    [[nodiscard]] constexpr int stone_count() const { return std::popcount(stones_of[0] | stones_of[1]); }
+};
+
+// the board of the trainer and of play's learned model
+using Board3x3 = StaticSpace<3, 3, 3>;
+
+static_assert(Board3x3::line_count == 8 && Board3x3::lines_per_cell == 4);
+
+#endif //STATIC_SPACE_H
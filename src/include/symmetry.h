@@ -0,0 +1,36 @@
+#ifndef SYMMETRY_H
+#define SYMMETRY_H
+
+#include <cstdint>
+#include "qtable.h"
+
+// The 8 symmetries of the square (rotations and reflections, the D4 group) acting on the 3x3 board.
+// Boards that are rotations or reflections of each other have the same value, so the Q-table only
+// needs to store one canonical representative of each group of symmetric boards.
+constexpr uint8_t symmetryCount = 8;
+
+// Number of boards that are the canonical representative of their symmetry group (by Burnside's
+// lemma, (3^9 + 2 * 3^3 + 3^5 + 4 * 3^6) / 8), and of canonical states with either player to move.
+constexpr uint32_t canonicalBoardCount = 2862;
+constexpr uint32_t canonicalStateCount = canonicalBoardCount * 2;
+
+struct CanonicalState {
+    // compact index of the canonical state, below canonicalStateCount
+    uint32_t slot;
+    // symmetry that maps the board onto its canonical representative
+    uint8_t transform;
+};
+
+// Cell (or 9-bit cell mask) that a cell moves to under a symmetry, and back.
+int transformCell(int cell, uint8_t transform);
+int inverseTransformCell(int cell, uint8_t transform);
+uint32_t transformMask(uint32_t mask, uint8_t transform);
+
+// Canonical slot of a dense state index (see getStateIndex) and the symmetry that gets there.
+// Actions map into the canonical frame with transformCell and back with inverseTransformCell.
+CanonicalState canonicalize(uint32_t state);
+
+// Dense state index (see getStateIndex) of the representative stored in a canonical slot.
+uint32_t canonicalStateIndex(uint32_t slot);
+
+#endif //SYMMETRY_H
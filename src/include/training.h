@@ -0,0 +1,121 @@
+#ifndef TRAINING_H
+#define TRAINING_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "qtable.h"
+
+// Stop training once learning has settled. Statistics are gathered per batch and judged over
+// windows of consecutive batches; a window passes when all of its numbers are within the limits,
+// and training stops after `patience` passing windows in a row. The states and the probe are
+// taken from the merge of every table, the policy train() returns, also in per-thread mode.
+struct EarlyStopping
+{
+    bool enabled = false;
+    // batches per evaluation window
+    unsigned int windowBatches = 20;
+    // Largest and mean |delta Q| of all updates in the window. Q-values stay within [-1, 1], so an
+    // update moves one by at most 2 * alpha, and alpha for a full reward, as the first win or loss
+    // of a rarely tried action. 0 allows 0.95 * alpha: a window passes once such updates are gone.
+    double maxDeltaQ = 0.0;
+    double meanDeltaQ = 0.01;
+    // states first visited during the window
+    unsigned long long maxNewStates = 0;
+    // Largest change of the win and draw rates against the probe opponent (a fixed-seed random
+    // player, see probeAgainstRandom) since the previous window. The change is counted with two
+    // standard errors of sampling noise added, about 0.008 at 20000 games, so probeGames has to
+    // be large enough for the tolerance to be met at all.
+    double probeTolerance = 0.02;
+    unsigned long long probeGames = 20000;
+    unsigned int patience = 3;
+};
+
+struct TrainingConfig
+{
+    // Q-learning hyperparameters
+    double alpha = 0.1;
+    double discount = 0.9;  // gamma, named so it does not clash with ::gamma() from <cmath>
+    double epsilon = 0.2;
+
+    // Learn on canonical boards, so all 8 rotations and reflections of a board share one Q row.
+    bool useSymmetry = true;
+
+    // Hogwild mode: every thread updates one shared table with relaxed atomic loads and stores
+    // instead of training a private table that is merged at the end. Concurrent updates of the
+    // same value may be lost, but memory stays constant and threads learn from each other live.
+    bool hogwild = false;
+
+    // Seed of the self-play random numbers, batch b of train() uses seed + b. 0 seeds from std::random_device.
+    uint64_t seed = 0;
+
+    // Episodes per batch handed out by train(). Smaller batches balance better, larger ones cost
+    // fewer scheduler operations.
+    unsigned int batchSize = 1000;
+
+    EarlyStopping earlyStopping;
+};
+
+// Work done by train().
+struct TrainingStats
+{
+    unsigned long long episodes = 0;
+    // moves played over all episodes
+    unsigned long long plies = 0;
+    // training ended before all episodes were played because config.earlyStopping was met
+    bool converged = false;
+};
+
+// Periodic checkpoints written by a background thread while train() runs.
+struct CheckpointConfig
+{
+    // binary model file (see model.h) the checkpoints are written to
+    std::string path = "ai_model.ckpt";
+    // seconds between two checkpoints, 0 disables checkpointing
+    unsigned int intervalSeconds = 0;
+};
+
+// Run a block of self-play episodes on the calling thread and learn into Q.
+// With config.hogwild set, Q may be shared by several threads running this at the same time.
+void trainEpisodes(unsigned long long episodes, DenseQTable &Q, const TrainingConfig &config);
+
+// Average the per-thread Q-tables. For states that appear in multiple tables, average their Q-values.
+// The rows are reduced in parallel shards on numThreads threads (0: one per hardware thread).
+DenseQTable mergeQTables(const std::vector<DenseQTable> &tables, unsigned int numThreads = 0);
+DenseQTable mergeQTables(const std::vector<const DenseQTable *> &tables, unsigned int numThreads = 0);
+
+// Train numEpisodes episodes on numThreads threads (0: one per hardware thread) and return the learned
+// table, either merged from per-thread tables or the single shared table in Hogwild mode.
+// Episodes run in batches of config.batchSize on a work-stealing scheduler: every thread starts with
+// an equal share of the batches and threads that run out steal from the others.
+//
+// With checkpoint.intervalSeconds set, a background thread periodically writes a binary model of
+// the progress so far, tagged with the episode count. In per-thread mode it asks every thread to
+// copy its table between two episodes and merges the copies, so training only pauses for one
+// table copy. In Hogwild mode it copies the shared table directly.
+//
+// To resume, pass the table and episode count of a checkpoint as resumeFrom and resumeEpisodes:
+// training starts from that table and checkpoints count episodes on top of resumeEpisodes.
+//
+// If stats is given, it receives the number of episodes and plies played by this call.
+DenseQTable train(unsigned long long numEpisodes, unsigned int numThreads, const TrainingConfig &config,
+                  const CheckpointConfig &checkpoint = {}, const DenseQTable *resumeFrom = nullptr,
+                  unsigned long long resumeEpisodes = 0, TrainingStats *stats = nullptr);
+
+// Memory of the Q-tables train() holds at once on numThreads threads (0: one per hardware thread)
+// for tables like Q: the shared table in Hogwild mode, otherwise every per-thread table plus the
+// merged one.
+uint64_t trainingTableBytes(const DenseQTable &Q, unsigned int numThreads, bool hogwild);
+
+// Outcome of the greedy policy of a table against a uniformly random opponent.
+struct ProbeResult
+{
+    unsigned long long wins = 0, draws = 0, losses = 0;
+
+    [[nodiscard]] unsigned long long games() const { return wins + draws + losses; }
+};
+
+// Play games with the greedy policy of Q against a random opponent, half of them as X and half as O.
+ProbeResult probeAgainstRandom(const DenseQTable &Q, unsigned long long games, uint64_t seed);
+
+#endif //TRAINING_H
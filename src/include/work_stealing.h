@@ -0,0 +1,37 @@
+#ifndef WORK_STEALING_H
+#define WORK_STEALING_H
+
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+// Hands out the items 0 .. count-1 to a fixed set of workers.
+// Every worker starts with an equal contiguous range and takes items from its front. A worker whose
+// range is empty steals the back half of the largest remaining range of another worker, so a slow
+// worker never holds up the others. Each range is one atomic word, nothing takes a lock.
+class WorkStealingRanges
+{
+private:
+    // [begin, end) packed as begin << 32 | end, on its own cache line
+    struct alignas(64) Range
+    {
+        std::atomic<uint64_t> bounds{0};
+    };
+    std::vector<Range> ranges;
+
+    static uint64_t pack(const uint32_t begin, const uint32_t end) { return static_cast<uint64_t>(begin) << 32 | end; }
+    static uint32_t beginOf(const uint64_t bounds) { return bounds >> 32; }
+    static uint32_t endOf(const uint64_t bounds) { return static_cast<uint32_t>(bounds); }
+
+    // move the back half of another range into the (empty) range of worker, false if nothing is left
+    bool steal(unsigned int worker);
+
+public:
+    // count must fit in 32 bits
+    WorkStealingRanges(uint32_t count, unsigned int workers);
+
+    // next item for worker, false once every range is empty
+    bool next(unsigned int worker, uint32_t &item);
+};
+
+#endif //WORK_STEALING_H
@@ -0,0 +1,221 @@
+#include "journal.h"
+
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include "model.h"
+
+namespace {
+    uint16_t checkOf(const JournalRecord &record) {
+        uint64_t bits;
+        std::memcpy(&bits, &record.value, sizeof(bits));
+        uint64_t z = bits ^ (static_cast<uint64_t>(record.state) << 16 | record.action);
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+        return static_cast<uint16_t>(z ^ (z >> 31));
+    }
+}
+
+Journal::~Journal() {
+    waitForCompaction();
+    flush();
+    if (file) {
+        std::fclose(file);
+    }
+}
+
+bool Journal::write(const std::string &filename, const uint64_t base, const std::vector<JournalRecord> &records) const {
+    JournalHeader header{};
+    std::memcpy(header.magic, JournalHeader::expectedMagic, sizeof(header.magic));
+    header.version = JournalHeader::currentVersion;
+    header.flags = canonical ? ModelHeader::canonicalFlag : 0;
+    header.base = base;
+
+    const std::string temporary = filename + ".tmp";
+    std::FILE *out = std::fopen(temporary.c_str(), "wb");
+    if (!out) {
+        std::cerr << "Error: failed to open " << temporary << " for writing.\n";
+        return false;
+    }
+    bool written = std::fwrite(&header, sizeof(header), 1, out) == 1
+        && std::fwrite(records.data(), sizeof(JournalRecord), records.size(), out) == records.size();
+    written = std::fclose(out) == 0 && written;
+    if (!written || std::rename(temporary.c_str(), filename.c_str()) != 0) {
+        std::cerr << "Error: failed to write " << filename << ".\n";
+        return false;
+    }
+    return true;
+}
+
+Journal::FileState Journal::readFile(const std::string &filename, uint64_t &base,
+                                     std::vector<JournalRecord> &records) const {
+    std::FILE *in = std::fopen(filename.c_str(), "rb");
+    if (!in) {
+        return FileState::missing;
+    }
+
+    JournalHeader header{};
+    if (std::fread(&header, sizeof(header), 1, in) != 1
+        || std::memcmp(header.magic, JournalHeader::expectedMagic, sizeof(header.magic)) != 0
+        || header.version != JournalHeader::currentVersion
+        || ((header.flags & ModelHeader::canonicalFlag) != 0) != canonical) {
+        std::cerr << "Error: " << filename << " is not a journal of this model.\n";
+        std::fclose(in);
+        return FileState::foreign;
+    }
+    base = header.base;
+
+    auto state = FileState::complete;
+    for (JournalRecord record{}; ; ) {
+        const size_t read = std::fread(&record, 1, sizeof(record), in);
+        if (read == 0 && !std::ferror(in)) {
+            break;
+        }
+        // a record cut short by a crash counts as damaged like a torn one
+        if (read != sizeof(record) || record.check != checkOf(record) || record.action >= boardCells
+            || record.state >= stateCount) {
+            std::cerr << "Warning: " << filename << " ends in a damaged record, dropped it and the rest.\n";
+            state = FileState::damaged;
+            break;
+        }
+        records.push_back(record);
+    }
+    std::fclose(in);
+    return state;
+}
+
+bool Journal::reopen() {
+    if (file) {
+        std::fclose(file);
+    }
+    file = std::fopen(path.c_str(), "ab");
+    if (!file) {
+        std::cerr << "Error: failed to open " << path << " for appending.\n";
+        return false;
+    }
+    return true;
+}
+
+bool Journal::open(const std::string &modelPath, OverlayModel &model, uint64_t *replayed) {
+    path = pathFor(modelPath);
+    canonical = model.isCanonical();
+    const uint64_t modelBase = model.base().identity();
+
+    // A compacting journal left by a crash continues the model if the crash came before the new
+    // model was written. The live journal then continues the snapshot that was never written and
+    // goes with it. Otherwise the model holds the compacting journal already, and the live journal
+    // has to continue the model itself.
+    std::vector<JournalRecord> older, records;
+    uint64_t olderBase = 0, liveBase = 0;
+    const auto olderState = readFile(compactingPath(), olderBase, older);
+    const auto liveState = readFile(path, liveBase, records);
+    if (olderState == FileState::foreign || liveState == FileState::foreign) {
+        return false;
+    }
+    const bool olderKept = olderState != FileState::missing && olderBase == modelBase;
+    const bool liveKept = liveState != FileState::missing && (liveBase == modelBase || olderKept);
+    if (olderState != FileState::missing && !olderKept && liveBase != modelBase) {
+        std::cerr << "Warning: " << compactingPath() << " belongs to another model, discarded it.\n";
+    }
+    if (liveState != FileState::missing && !liveKept) {
+        std::cerr << "Warning: " << path << " belongs to another model, discarded it.\n";
+    }
+    if (!liveKept) {
+        records.clear();
+    }
+    if (olderKept) {
+        records.insert(records.begin(), older.begin(), older.end());
+    }
+    for (const auto &record : records) {
+        model.update(record.state)[record.action] = record.value;
+    }
+    if (replayed != nullptr) {
+        *replayed = records.size();
+    }
+
+    recordCount = records.size();
+    if (liveState == FileState::complete && liveKept && olderState == FileState::missing) {
+        return reopen();
+    }
+
+    // Gather everything replayed into a fresh live journal of the model: that cuts off a damaged
+    // tail, so new records never follow garbage, retires a compacting journal left by a crash and
+    // replaces a journal of another model. The compacting journal goes only once the live one
+    // holds its records.
+    if (!write(path, modelBase, records)) {
+        return false;
+    }
+    std::remove(compactingPath().c_str());
+    return reopen();
+}
+
+void Journal::append(const uint32_t state, const uint32_t action, const double value) {
+    JournalRecord record{};
+    record.state = state;
+    record.action = static_cast<uint16_t>(action);
+    record.value = value;
+    record.check = checkOf(record);
+    buffer.push_back(record);
+    ++recordCount;
+}
+
+bool Journal::flush() {
+    if (!file || buffer.empty()) {
+        return true;
+    }
+    const bool written = std::fwrite(buffer.data(), sizeof(JournalRecord), buffer.size(), file) == buffer.size()
+        && std::fflush(file) == 0;
+    buffer.clear();
+    if (!written) {
+        std::cerr << "Error: failed to append to " << path << ".\n";
+    }
+    return written;
+}
+
+bool Journal::compact(const OverlayModel &model, const std::string &modelPath, const bool wait) {
+    if (compactor.joinable() && !compacted.load(std::memory_order_acquire)) {
+        return false;
+    }
+    // an earlier compaction that has finished
+    waitForCompaction();
+    if (!flush()) {
+        return false;
+    }
+    // a compacting journal still there means the last compaction failed, its updates are not in
+    // the model yet and it must not be overwritten; open() merges it back on the next start
+    if (std::filesystem::exists(compactingPath())) {
+        std::cerr << "Error: " << compactingPath() << " was not folded into the model, not compacting.\n";
+        return false;
+    }
+    if (std::rename(path.c_str(), compactingPath().c_str()) != 0) {
+        std::cerr << "Error: failed to rotate " << path << ".\n";
+        return false;
+    }
+    // the fresh journal continues the snapshot the compactor writes
+    const uint64_t episodes = model.base().episodes();
+    DenseQTable snapshot = model.toDenseQTable();
+    if (!write(path, modelIdentity(snapshot, episodes), {}) || !reopen()) {
+        return false;
+    }
+    recordCount = 0;
+
+    compacted.store(false, std::memory_order_relaxed);
+    compactor = std::thread([this, snapshot = std::move(snapshot), modelPath, episodes, old = compactingPath()] {
+        // the old journal has to stay until the model holding its updates is in place
+        if (writeModel(snapshot, modelPath, episodes, true)) {
+            std::remove(old.c_str());
+        }
+        compacted.store(true, std::memory_order_release);
+    });
+    if (wait) {
+        waitForCompaction();
+    }
+    return true;
+}
+
+void Journal::waitForCompaction() {
+    if (compactor.joinable()) {
+        compactor.join();
+    }
+}
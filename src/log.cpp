@@ -1,5 +1,12 @@
 #include "log.hpp"
+#include <algorithm>
+#include <bit>
+#include <chrono>
 #include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <thread>
+#include <vector>
 
 std::string getEnvVar(const std::string &key)
 {
@@ -25,10 +32,233 @@ std::string getEnvVar(const std::string &key)
 }
 
 std::mutex debug::log_mutex;
-std::string debug::str_true = "True";
-std::string debug::str_false = "False";
+std::atomic < bool > debug::lower_case_bools = false;
 decltype(debug::log_level) debug::log_level = INFO;
-decltype(debug::current_level) debug::current_level = INFO;
+thread_local debug::log_level_t debug::current_level = INFO;
+
+namespace {
+    // Byte ring written by one thread and read by the async writer. A record is its uint32_t length
+    // followed by its text; head and tail only grow and are taken modulo the capacity.
+    struct log_ring
+    {
+        std::vector<char> data;
+        std::atomic<uint64_t> head{0}, tail{0};
+        // the owner is inside async_log_submit, stop_async_log waits for this to clear
+        std::atomic<bool> writing{false};
+        // the owning thread has exited, the ring is dropped once it is empty
+        std::atomic<bool> orphaned{false};
+
+        explicit log_ring(const std::size_t capacity) : data(capacity) { }
+
+        void copy_in(const uint64_t position, const char *source, const std::size_t size)
+        {
+            const auto offset = position & (data.size() - 1);
+            const auto first = std::min(size, data.size() - offset);
+            std::memcpy(data.data() + offset, source, first);
+            std::memcpy(data.data(), source + first, size - first);
+        }
+
+        void copy_out(const uint64_t position, char *target, const std::size_t size) const
+        {
+            const auto offset = position & (data.size() - 1);
+            const auto first = std::min(size, data.size() - offset);
+            std::memcpy(target, data.data() + offset, first);
+            std::memcpy(target + first, data.data(), size - first);
+        }
+
+        // producer side, false if the record does not fit right now
+        bool push(const std::string &record)
+        {
+            const auto size = static_cast<uint32_t>(record.size());
+            const uint64_t position = tail.load(std::memory_order_relaxed);
+            if (sizeof(size) + size > data.size() - (position - head.load(std::memory_order_acquire))) {
+                return false;
+            }
+            copy_in(position, reinterpret_cast<const char *>(&size), sizeof(size));
+            copy_in(position + sizeof(size), record.data(), size);
+            tail.store(position + sizeof(size) + size, std::memory_order_release);
+            return true;
+        }
+
+        // consumer side, append every queued record to out
+        void drain(std::string &out)
+        {
+            uint64_t position = head.load(std::memory_order_relaxed);
+            const uint64_t end = tail.load(std::memory_order_acquire);
+            while (position < end) {
+                uint32_t size;
+                copy_out(position, reinterpret_cast<char *>(&size), sizeof(size));
+                const auto offset = out.size();
+                out.resize(offset + size);
+                copy_out(position + sizeof(size), out.data() + offset, size);
+                position += sizeof(size) + size;
+            }
+            head.store(position, std::memory_order_release);
+        }
+    };
+
+    struct async_log_state
+    {
+        // serializes start_async_log and stop_async_log
+        std::mutex control;
+        // guards rings, taken by a thread once for its first record and by the writer per batch
+        std::mutex registry;
+        std::vector<std::shared_ptr<log_ring>> rings;
+        std::thread writer;
+        std::atomic<bool> running{false};
+        std::size_t capacity = 1 << 16;
+        debug::overflow_policy policy = debug::overflow_policy::drop;
+        std::atomic<uint64_t> dropped{0};
+    };
+
+    async_log_state & async_state()
+    {
+        static async_log_state state;
+        return state;
+    }
+
+    // this thread's ring, marked orphaned when the thread exits
+    struct ring_owner
+    {
+        std::shared_ptr<log_ring> ring;
+
+        ~ring_owner()
+        {
+            if (ring) {
+                ring->orphaned.store(true, std::memory_order_release);
+            }
+        }
+    };
+
+    log_ring & this_thread_ring()
+    {
+        thread_local ring_owner owner;
+        if (!owner.ring) {
+            auto &state = async_state();
+            owner.ring = std::make_shared<log_ring>(state.capacity);
+            std::lock_guard<std::mutex> lock(state.registry);
+            state.rings.push_back(owner.ring);
+        }
+        return *owner.ring;
+    }
+
+    // move every queued record into batch, forgetting rings of exited threads once they are empty
+    void drain_rings(async_log_state &state, std::string &batch)
+    {
+        std::lock_guard<std::mutex> lock(state.registry);
+        std::erase_if(state.rings, [&](const std::shared_ptr<log_ring> &ring) {
+            const bool orphaned = ring->orphaned.load(std::memory_order_acquire);
+            ring->drain(batch);
+            return orphaned;
+        });
+    }
+
+    void write_batch(const std::string &batch)
+    {
+        std::lock_guard<std::mutex> lock(debug::log_mutex);
+        auto &device = debug::log_stream();
+        device.write(batch.data(), static_cast<std::streamsize>(batch.size()));
+        device.flush();
+    }
+
+    void writer_loop(async_log_state &state)
+    {
+        std::string batch;
+        uint64_t reported = 0;
+        bool running = true;
+        while (running) {
+            running = state.running.load(std::memory_order_acquire);
+            batch.clear();
+            drain_rings(state, batch);
+            if (const auto dropped = state.dropped.load(std::memory_order_relaxed); dropped != reported) {
+                batch += "[WARNING] " + std::to_string(dropped - reported) + " log records dropped\n";
+                reported = dropped;
+            }
+            if (batch.empty()) {
+                // nothing queued, poll again shortly
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                continue;
+            }
+            write_batch(batch);
+        }
+    }
+}
+
+std::atomic < bool > debug::async_log_enabled = false;
+
+void debug::start_async_log(const std::size_t ring_capacity, const overflow_policy policy)
+{
+    auto &state = async_state();
+    std::lock_guard<std::mutex> lock(state.control);
+    if (async_log_enabled.load()) {
+        return;
+    }
+
+    // rings of threads that already logged keep their size
+    state.capacity = std::bit_ceil(std::max<std::size_t>(ring_capacity, 64));
+    state.policy = policy;
+    state.running.store(true);
+    state.writer = std::thread(writer_loop, std::ref(state));
+    static const bool stop_at_exit = (std::atexit(stop_async_log), true);
+    (void)stop_at_exit;
+    async_log_enabled.store(true);
+}
+
+void debug::stop_async_log()
+{
+    auto &state = async_state();
+    std::lock_guard<std::mutex> lock(state.control);
+    if (!async_log_enabled.exchange(false)) {
+        return;
+    }
+
+    // Producers that saw async mode still enabled finish their record before the writer goes.
+    // A producer blocked on a full ring gets room from the writer, which is still running and
+    // needs the registry for that, so wait on a copy of the rings rather than under the lock.
+    std::vector<std::shared_ptr<log_ring>> rings;
+    {
+        std::lock_guard<std::mutex> registry(state.registry);
+        rings = state.rings;
+    }
+    for (const auto &ring : rings) {
+        while (ring->writing.load()) {
+            std::this_thread::yield();
+        }
+    }
+    // the writer drains everything once more before it returns
+    state.running.store(false, std::memory_order_release);
+    state.writer.join();
+}
+
+uint64_t debug::dropped_log_records()
+{
+    return async_state().dropped.load(std::memory_order_relaxed);
+}
+
+bool debug::async_log_submit(const std::string & record)
+{
+    auto &state = async_state();
+    auto &ring = this_thread_ring();
+
+    // paired with stop_async_log: either it sees writing set and waits, or this sees async mode off
+    ring.writing.store(true);
+    if (!async_log_enabled.load()) {
+        ring.writing.store(false, std::memory_order_release);
+        return false;
+    }
+
+    bool pushed = ring.push(record);
+    if (!pushed && state.policy == overflow_policy::block && sizeof(uint32_t) + record.size() <= ring.data.size()) {
+        while (!(pushed = ring.push(record))) {
+            std::this_thread::yield();
+        }
+    }
+    if (!pushed) {
+        state.dropped.fetch_add(1, std::memory_order_relaxed);
+    }
+    ring.writing.store(false, std::memory_order_release);
+    return true;
+}
 
 class init_log_level {
 public:
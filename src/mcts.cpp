@@ -0,0 +1,188 @@
+#include "mcts.h"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <thread>
+
+Mcts::Mcts(const MctsConfig &config)
+    : config(config), pool(std::max(1u, config.nodeCapacity))
+{
+}
+
+bool Mcts::allocate(const uint32_t count, uint32_t &first) {
+    uint32_t current = used.load(std::memory_order_relaxed);
+    do {
+        if (pool.size() - current < count) {
+            return false;
+        }
+    } while (!used.compare_exchange_weak(current, current + count, std::memory_order_relaxed));
+    first = current;
+    return true;
+}
+
+void Mcts::resetNode(const uint32_t index, const int32_t move) {
+    Node &node = pool[index];
+    node.visits.store(0, std::memory_order_relaxed);
+    node.score.store(0, std::memory_order_relaxed);
+    node.state.store(0, std::memory_order_relaxed);
+    node.children = 0;
+    node.childCount = 0;
+    node.move = move;
+}
+
+void Mcts::expand(Node &node, const Space &board) {
+    uint8_t leaf = 0;
+    if (!node.state.compare_exchange_strong(leaf, 1, std::memory_order_acquire, std::memory_order_relaxed)) {
+        return;  // another thread is on it
+    }
+
+    const Bitboard free = board.empty_cells();
+    uint32_t first;
+    if (!allocate(static_cast<uint32_t>(free.count()), first)) {
+        node.state.store(0, std::memory_order_relaxed);
+        return;
+    }
+    uint32_t next = first;
+    free.for_each([&](const uint64_t cell) { resetNode(next++, static_cast<int32_t>(cell)); });
+    node.children = first;
+    node.childCount = next - first;
+    node.state.store(2, std::memory_order_release);
+}
+
+uint32_t Mcts::select(const Node &node) const {
+    const double logVisits = std::log(std::max<uint32_t>(1, node.visits.load(std::memory_order_relaxed)));
+    double bestValue = -1.0;
+    uint32_t best = node.children;
+    for (uint32_t i = node.children; i < node.children + node.childCount; ++i) {
+        const uint32_t visits = pool[i].visits.load(std::memory_order_relaxed);
+        if (visits == 0) {
+            return i;
+        }
+        const double mean = pool[i].score.load(std::memory_order_relaxed) / (2.0 * visits);
+        if (const double value = mean + config.exploration * std::sqrt(logVisits / visits); value > bestValue) {
+            bestValue = value;
+            best = i;
+        }
+    }
+    return best;
+}
+
+void Mcts::worker(const Space &game, const signed char player, const unsigned int index,
+                  std::atomic<uint64_t> &playouts, const std::chrono::steady_clock::time_point deadline) {
+    std::mt19937_64 gen(config.seed != 0 ? config.seed + index : std::random_device{}());
+    const auto width = static_cast<int>(game.get_width());
+    const uint64_t rootEmpty = game.empty_cells().count();
+    Space board;
+    std::vector<uint32_t> path;
+    std::vector<int> empty;
+
+    while (true) {
+        if (config.playouts != 0 && playouts.fetch_add(1, std::memory_order_relaxed) >= config.playouts) {
+            break;
+        }
+        if (config.seconds > 0 && std::chrono::steady_clock::now() >= deadline) {
+            break;
+        }
+
+        board = game;
+        auto toMove = player;
+        int winner = -1;
+        bool over = false;
+        uint64_t remaining = rootEmpty;
+        path.assign(1, 0);
+        pool[0].visits.fetch_add(1, std::memory_order_relaxed);
+
+        // Selection: walk down the expanded part of the tree, counting the visit right away.
+        uint32_t current = 0;
+        while (pool[current].state.load(std::memory_order_acquire) == 2) {
+            current = select(pool[current]);
+            path.push_back(current);
+            pool[current].visits.fetch_add(1, std::memory_order_relaxed);
+
+            const int cell = pool[current].move;
+            board.make_move(cell % width, cell / width, toMove);
+            if (board.check_win(cell % width, cell / width) != -1) {
+                winner = toMove;
+                over = true;
+                break;
+            }
+            toMove = static_cast<signed char>(1 - toMove);
+            if (--remaining == 0) {
+                over = true;
+                break;
+            }
+        }
+
+        if (!over) {
+            // Expansion: a leaf grows its children on its second visit, so single visits stay cheap.
+            if (pool[current].visits.load(std::memory_order_relaxed) > 1) {
+                expand(pool[current], board);
+            }
+
+            // Simulation: uniformly random moves until someone wins or the board is full.
+            empty.clear();
+            board.empty_cells().for_each([&](const uint64_t cell) { empty.push_back(static_cast<int>(cell)); });
+            while (!empty.empty()) {
+                const size_t pick = std::uniform_int_distribution<size_t>(0, empty.size() - 1)(gen);
+                const int cell = empty[pick];
+                empty[pick] = empty.back();
+                empty.pop_back();
+                board.make_move(cell % width, cell / width, toMove);
+                if (board.check_win(cell % width, cell / width) != -1) {
+                    winner = toMove;
+                    break;
+                }
+                toMove = static_cast<signed char>(1 - toMove);
+            }
+        }
+
+        // Backpropagation: the node at depth d was entered by player for odd d, by the opponent for even d.
+        for (size_t depth = 0; depth < path.size(); ++depth) {
+            const auto mover = static_cast<signed char>(depth % 2 == 1 ? player : 1 - player);
+            const uint64_t reward = winner == -1 ? 1 : winner == mover ? 2 : 0;
+            if (reward != 0) {
+                pool[path[depth]].score.fetch_add(reward, std::memory_order_relaxed);
+            }
+        }
+    }
+}
+
+MctsResult Mcts::search(const Space &game, const signed char player) {
+    const auto start = std::chrono::steady_clock::now();
+    const auto deadline = start + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+        std::chrono::duration<double>(config.seconds));
+
+    used.store(1, std::memory_order_relaxed);
+    resetNode(0, -1);
+    MctsResult result;
+    if (!game.empty_cells().any()) {
+        return result;
+    }
+    expand(pool[0], game);
+
+    std::atomic<uint64_t> playouts{0};
+    const unsigned int threads = config.threads != 0 ? config.threads : std::max(1u, std::thread::hardware_concurrency());
+    std::vector<std::thread> workers;
+    workers.reserve(threads);
+    for (unsigned int i = 0; i < threads; ++i) {
+        workers.emplace_back([&, i] { worker(game, player, i, playouts, deadline); });
+    }
+    for (auto &thread : workers) {
+        thread.join();
+    }
+
+    const Node &root = pool[0];
+    uint32_t bestVisits = 0;
+    for (uint32_t i = root.children; i < root.children + root.childCount; ++i) {
+        if (const uint32_t visits = pool[i].visits.load(std::memory_order_relaxed); visits > bestVisits || result.move < 0) {
+            bestVisits = visits;
+            result.move = pool[i].move;
+            result.value = visits ? pool[i].score.load(std::memory_order_relaxed) / (2.0 * visits) : 0.0;
+        }
+    }
+    result.playouts = root.visits.load(std::memory_order_relaxed);
+    result.nodes = used.load(std::memory_order_relaxed);
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return result;
+}
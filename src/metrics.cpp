@@ -0,0 +1,258 @@
+#include "metrics.hpp"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+
+namespace {
+    enum class metric_kind { counter, gauge, histogram };
+
+    struct metric_entry
+    {
+        std::string name, help;
+        metric_kind kind;
+        std::size_t slot = 0;
+        const metrics::gauge * gauge = nullptr;
+        const metrics::histogram * histogram = nullptr;
+    };
+
+    struct shard;
+
+    struct registry_t
+    {
+        std::mutex mutex;
+        std::vector < metric_entry > entries;
+        std::size_t next_slot = 0;
+        // slots holding the bits of a double (histogram sums) instead of a count
+        std::array < bool, metrics::max_slots > double_slot{};
+        std::vector < shard * > shards;
+        // totals of threads that have exited
+        std::array < std::uint64_t, metrics::max_slots > retired{};
+
+        std::mutex dump_mutex;
+        std::condition_variable dump_signal;
+        std::thread dump_thread;
+        bool dump_stopping = false;
+        std::string dump_path;
+
+        std::size_t reserve(const std::size_t count)
+        {
+            if (next_slot + count > metrics::max_slots) {
+                throw std::length_error("metrics: out of value slots");
+            }
+            next_slot += count;
+            return next_slot - count;
+        }
+
+        // add a slot value to a running total, as a count or as a double
+        void accumulate(const std::size_t slot, std::uint64_t & total, const std::uint64_t value) const
+        {
+            total = double_slot[slot]
+                ? std::bit_cast < std::uint64_t > (std::bit_cast < double > (total) + std::bit_cast < double > (value))
+                : total + value;
+        }
+    };
+
+    registry_t & registry()
+    {
+        static registry_t instance;
+        return instance;
+    }
+
+    // One thread's values. Only the owner writes them; readers take relaxed loads.
+    struct shard
+    {
+        std::array < std::atomic < std::uint64_t >, metrics::max_slots > values{};
+
+        shard()
+        {
+            auto & r = registry();
+            std::lock_guard < std::mutex > lock(r.mutex);
+            r.shards.push_back(this);
+        }
+
+        ~shard()
+        {
+            auto & r = registry();
+            std::lock_guard < std::mutex > lock(r.mutex);
+            for (std::size_t slot = 0; slot < r.next_slot; ++slot) {
+                r.accumulate(slot, r.retired[slot], values[slot].load(std::memory_order_relaxed));
+            }
+            std::erase(r.shards, this);
+        }
+    };
+
+    shard & local_shard()
+    {
+        thread_local shard instance;
+        return instance;
+    }
+
+    // sum of a slot over every thread, registry mutex held
+    std::uint64_t total_locked(const registry_t & r, const std::size_t slot)
+    {
+        std::uint64_t total = r.retired[slot];
+        for (const auto * s : r.shards) {
+            r.accumulate(slot, total, s->values[slot].load(std::memory_order_relaxed));
+        }
+        return total;
+    }
+
+    void add_entry(metric_entry entry)
+    {
+        auto & r = registry();
+        std::lock_guard < std::mutex > lock(r.mutex);
+        r.entries.push_back(std::move(entry));
+    }
+}
+
+metrics::counter::counter(const std::string & name, const std::string & help)
+{
+    auto & r = registry();
+    {
+        std::lock_guard < std::mutex > lock(r.mutex);
+        slot = r.reserve(1);
+    }
+    add_entry({ name, help, metric_kind::counter, slot });
+}
+
+void metrics::counter::inc(const std::uint64_t n) const
+{
+    // only this thread writes the slot, so load + store is enough and compiles to a plain add
+    auto & value = local_shard().values[slot];
+    value.store(value.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+}
+
+std::uint64_t metrics::counter::value() const
+{
+    auto & r = registry();
+    std::lock_guard < std::mutex > lock(r.mutex);
+    return total_locked(r, slot);
+}
+
+metrics::gauge::gauge(const std::string & name, const std::string & help)
+{
+    add_entry({ name, help, metric_kind::gauge, 0, this });
+}
+
+metrics::histogram::histogram(const std::string & name, const std::string & help, std::vector < double > upper_bounds)
+    : bounds(std::move(upper_bounds))
+{
+    std::ranges::sort(bounds);
+    auto & r = registry();
+    {
+        std::lock_guard < std::mutex > lock(r.mutex);
+        first_slot = r.reserve(bounds.size() + 2);
+        r.double_slot[first_slot + bounds.size() + 1] = true;
+    }
+    add_entry({ name, help, metric_kind::histogram, first_slot, nullptr, this });
+}
+
+void metrics::histogram::observe(const double value) const
+{
+    auto & values = local_shard().values;
+    const auto bucket = static_cast<std::size_t>(std::ranges::lower_bound(bounds, value) - bounds.begin());
+    auto & count = values[first_slot + bucket];
+    count.store(count.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    auto & sum = values[first_slot + bounds.size() + 1];
+    sum.store(std::bit_cast < std::uint64_t > (std::bit_cast < double > (sum.load(std::memory_order_relaxed)) + value),
+              std::memory_order_relaxed);
+}
+
+std::vector < double > metrics::latency_buckets()
+{
+    return { 0.0001, 0.00025, 0.0005, 0.001, 0.0025, 0.005, 0.01, 0.025, 0.05, 0.1, 0.25, 0.5, 1, 2.5, 5, 10 };
+}
+
+std::string metrics::exposition()
+{
+    auto & r = registry();
+    std::ostringstream out;
+    out.precision(12);
+    std::lock_guard < std::mutex > lock(r.mutex);
+    for (const auto & entry : r.entries) {
+        out << "# HELP " << entry.name << ' ' << entry.help << '\n';
+        switch (entry.kind) {
+        case metric_kind::counter:
+            out << "# TYPE " << entry.name << " counter\n"
+                << entry.name << ' ' << total_locked(r, entry.slot) << '\n';
+            break;
+        case metric_kind::gauge:
+            out << "# TYPE " << entry.name << " gauge\n"
+                << entry.name << ' ' << entry.gauge->value() << '\n';
+            break;
+        case metric_kind::histogram: {
+            out << "# TYPE " << entry.name << " histogram\n";
+            const auto & bounds = entry.histogram->upper_bounds();
+            std::uint64_t cumulative = 0;
+            for (std::size_t bucket = 0; bucket <= bounds.size(); ++bucket) {
+                cumulative += total_locked(r, entry.slot + bucket);
+                out << entry.name << "_bucket{le=\"";
+                if (bucket < bounds.size()) {
+                    out << bounds[bucket];
+                } else {
+                    out << "+Inf";
+                }
+                out << "\"} " << cumulative << '\n';
+            }
+            out << entry.name << "_sum " << std::bit_cast < double > (total_locked(r, entry.slot + bounds.size() + 1)) << '\n'
+                << entry.name << "_count " << cumulative << '\n';
+            break;
+        }
+        }
+    }
+    return out.str();
+}
+
+bool metrics::write_file(const std::string & path)
+{
+    const std::string temporary = path + ".tmp";
+    {
+        std::ofstream out(temporary, std::ios::trunc);
+        out << exposition();
+        if (!out) {
+            return false;
+        }
+    }
+    return std::rename(temporary.c_str(), path.c_str()) == 0;
+}
+
+void metrics::start_periodic_dump(const std::string & path, const std::chrono::milliseconds interval)
+{
+    stop_periodic_dump();
+    auto & r = registry();
+    std::lock_guard < std::mutex > lock(r.dump_mutex);
+    r.dump_path = path;
+    r.dump_stopping = false;
+    r.dump_thread = std::thread([&r, interval] {
+        std::unique_lock < std::mutex > wait(r.dump_mutex);
+        while (!r.dump_signal.wait_for(wait, interval, [&r] { return r.dump_stopping; })) {
+            write_file(r.dump_path);
+        }
+    });
+    static const bool stop_at_exit = (std::atexit(stop_periodic_dump), true);
+    (void)stop_at_exit;
+}
+
+void metrics::stop_periodic_dump()
+{
+    auto & r = registry();
+    {
+        std::lock_guard < std::mutex > lock(r.dump_mutex);
+        if (!r.dump_thread.joinable()) {
+            return;
+        }
+        r.dump_stopping = true;
+    }
+    r.dump_signal.notify_all();
+    r.dump_thread.join();
+    write_file(r.dump_path);
+}
@@ -0,0 +1,293 @@
+#include "model.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <utility>
+#include "journal.h"
+#include "symmetry.h"
+
+#if defined(__unix__) || defined(__APPLE__)
+# define MODEL_HAS_MMAP
+# include <fcntl.h>
+# include <sys/mman.h>
+# include <sys/stat.h>
+# include <unistd.h>
+#endif
+
+namespace {
+    // (state, row) of every visited row, sorted by state for the binary search in MappedModel
+    std::vector<std::pair<uint32_t, uint32_t>> sortedEntries(const DenseQTable &Q) {
+        std::vector<std::pair<uint32_t, uint32_t>> entries;
+        entries.reserve(Q.size());
+        for (uint32_t index = 0; index < Q.rowCount(); ++index) {
+            if (Q.isVisited(index)) {
+                entries.emplace_back(Q.isCanonical() ? canonicalStateIndex(index) : index, index);
+            }
+        }
+        std::ranges::sort(entries);
+        return entries;
+    }
+
+    uint64_t mix(uint64_t hash, const uint64_t value) {
+        hash = (hash ^ value) * 0x9e3779b97f4a7c15ULL;
+        return hash ^ (hash >> 32);
+    }
+
+    // running hash of one entry, keys in ascending order as in the file
+    uint64_t mixEntry(uint64_t hash, const uint32_t state, const double *values) {
+        hash = mix(hash, state);
+        for (uint32_t a = 0; a < boardCells; ++a) {
+            uint64_t bits;
+            std::memcpy(&bits, &values[a], sizeof(bits));
+            hash = mix(hash, bits);
+        }
+        return hash;
+    }
+}
+
+bool writeModel(const DenseQTable &Q, const std::string &filename, const uint64_t episodes, const bool keepJournal) {
+    const auto entries = sortedEntries(Q);
+
+    ModelHeader header{};
+    std::memcpy(header.magic, ModelHeader::expectedMagic, sizeof(header.magic));
+    header.version = ModelHeader::currentVersion;
+    header.flags = Q.isCanonical() ? ModelHeader::canonicalFlag : 0;
+    header.actions = boardCells;
+    header.entryCount = static_cast<uint32_t>(entries.size());
+    header.episodes = episodes;
+    header.keysOffset = sizeof(ModelHeader);
+    // keep the doubles 8-byte aligned
+    header.valuesOffset = (header.keysOffset + entries.size() * sizeof(uint32_t) + 7) / 8 * 8;
+
+    const std::string temporary = filename + ".tmp";
+    std::ofstream out(temporary, std::ios::binary | std::ios::trunc);
+    if (!out) {
+        std::cerr << "Error: failed to open " << temporary << " for writing.\n";
+        return false;
+    }
+    out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    for (const auto &[state, index] : entries) {
+        out.write(reinterpret_cast<const char *>(&state), sizeof(state));
+    }
+    constexpr char padding[8] = {};
+    out.write(padding, static_cast<std::streamsize>(header.valuesOffset - header.keysOffset - entries.size() * sizeof(uint32_t)));
+    for (const auto &[state, index] : entries) {
+        out.write(reinterpret_cast<const char *>(Q.row(index)), boardCells * sizeof(double));
+    }
+    out.close();
+    if (!out) {
+        std::cerr << "Error: failed to write " << temporary << ".\n";
+        return false;
+    }
+
+    if (std::rename(temporary.c_str(), filename.c_str()) != 0) {
+        std::cerr << "Error: failed to replace " << filename << ".\n";
+        return false;
+    }
+    // a crash before this leaves journals of the old model, open() tells them apart by identity
+    if (!keepJournal) {
+        std::remove(Journal::pathFor(filename).c_str());
+        std::remove(Journal::compactingPathFor(filename).c_str());
+    }
+    return true;
+}
+
+uint64_t modelIdentity(const DenseQTable &Q, const uint64_t episodes) {
+    uint64_t hash = mix(0, episodes);
+    for (const auto &[state, index] : sortedEntries(Q)) {
+        hash = mixEntry(hash, state, Q.row(index));
+    }
+    return hash;
+}
+
+bool isBinaryModel(const std::string &filename) {
+    std::ifstream in(filename, std::ios::binary);
+    char magic[sizeof(ModelHeader::expectedMagic)] = {};
+    in.read(magic, sizeof(magic));
+    return in && std::memcmp(magic, ModelHeader::expectedMagic, sizeof(magic)) == 0;
+}
+
+MappedModel::~MappedModel() {
+    close();
+}
+
+MappedModel::MappedModel(MappedModel &&other) noexcept {
+    *this = std::move(other);
+}
+
+MappedModel &MappedModel::operator=(MappedModel &&other) noexcept {
+    if (this != &other) {
+        close();
+        path = std::move(other.path);
+        base = std::exchange(other.base, nullptr);
+        length = std::exchange(other.length, 0);
+        writable = std::exchange(other.writable, false);
+        fallback = std::move(other.fallback);
+        header = std::exchange(other.header, nullptr);
+        keys = std::exchange(other.keys, nullptr);
+        values = std::exchange(other.values, nullptr);
+    }
+    return *this;
+}
+
+void MappedModel::close() {
+#ifdef MODEL_HAS_MMAP
+    if (base && fallback.empty()) {
+        munmap(base, length);
+    }
+#endif
+    base = nullptr;
+    header = nullptr;
+    keys = nullptr;
+    values = nullptr;
+    length = 0;
+    fallback.clear();
+}
+
+bool MappedModel::open(const std::string &filename, const bool writable) {
+    close();
+    path = filename;
+    this->writable = writable;
+
+#ifdef MODEL_HAS_MMAP
+    const int fd = ::open(filename.c_str(), writable ? O_RDWR : O_RDONLY);
+    if (fd < 0) {
+        std::cerr << "Error: failed to open " << filename << "\n";
+        return false;
+    }
+    struct stat info{};
+    if (fstat(fd, &info) != 0 || info.st_size < static_cast<off_t>(sizeof(ModelHeader))) {
+        ::close(fd);
+        std::cerr << "Error: " << filename << " is not a binary model\n";
+        return false;
+    }
+    length = info.st_size;
+    void *mapped = mmap(nullptr, length, PROT_READ | (writable ? PROT_WRITE : 0), MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (mapped == MAP_FAILED) {
+        length = 0;
+        std::cerr << "Error: failed to map " << filename << "\n";
+        return false;
+    }
+    base = static_cast<unsigned char *>(mapped);
+#else
+    std::ifstream in(filename, std::ios::binary);
+    if (!in) {
+        std::cerr << "Error: failed to open " << filename << "\n";
+        return false;
+    }
+    fallback.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    base = fallback.data();
+    length = fallback.size();
+#endif
+
+    // Validate everything once, lookups and toDenseQTable trust the layout and the keys afterwards.
+    // At most stateCount entries keep the offset arithmetic far from overflowing once both offsets
+    // are known to lie within the file.
+    const auto *candidate = reinterpret_cast<const ModelHeader *>(base);
+    if (length < sizeof(ModelHeader)
+        || std::memcmp(candidate->magic, ModelHeader::expectedMagic, sizeof(candidate->magic)) != 0
+        || candidate->version != ModelHeader::currentVersion
+        || candidate->actions != boardCells
+        || candidate->entryCount > stateCount
+        || candidate->keysOffset < sizeof(ModelHeader)
+        || candidate->keysOffset % alignof(uint32_t) != 0
+        || candidate->keysOffset > candidate->valuesOffset
+        || candidate->valuesOffset > length
+        || candidate->keysOffset + static_cast<uint64_t>(candidate->entryCount) * sizeof(uint32_t) > candidate->valuesOffset
+        || candidate->valuesOffset % alignof(double) != 0
+        || candidate->valuesOffset + static_cast<uint64_t>(candidate->entryCount) * boardCells * sizeof(double) > length)
+    {
+        std::cerr << "Error: " << filename << " is not a binary model (version " << ModelHeader::currentVersion
+                  << "), convert text models with model_convert\n";
+        close();
+        return false;
+    }
+
+    // keys index dense tables, so every one has to be a state and they have to be strictly
+    // ascending for the binary search
+    const auto *candidateKeys = reinterpret_cast<const uint32_t *>(base + candidate->keysOffset);
+    for (uint32_t i = 0; i < candidate->entryCount; ++i) {
+        if (candidateKeys[i] >= stateCount || (i > 0 && candidateKeys[i] <= candidateKeys[i - 1])) {
+            std::cerr << "Error: " << filename << " is damaged, entry " << i << " has an invalid state\n";
+            close();
+            return false;
+        }
+    }
+
+    header = candidate;
+    keys = candidateKeys;
+    values = reinterpret_cast<double *>(base + header->valuesOffset);
+    return true;
+}
+
+const double *MappedModel::find(const uint32_t state) const {
+    const uint32_t *end = keys + header->entryCount;
+    const uint32_t *it = std::lower_bound(keys, end, state);
+    if (it == end || *it != state) {
+        return nullptr;
+    }
+    return values + static_cast<uint64_t>(it - keys) * boardCells;
+}
+
+double *MappedModel::findMutable(const uint32_t state) {
+    return writable ? const_cast<double *>(find(state)) : nullptr;
+}
+
+uint64_t MappedModel::identity() const {
+    uint64_t hash = mix(0, episodes());
+    for (uint32_t i = 0; i < size(); ++i) {
+        hash = mixEntry(hash, keys[i], valuesAt(i));
+    }
+    return hash;
+}
+
+void MappedModel::sync() {
+#ifdef MODEL_HAS_MMAP
+    if (base && writable) {
+        msync(base, length, MS_SYNC);
+    }
+#else
+    if (base && writable) {
+        std::ofstream out(path, std::ios::binary | std::ios::trunc);
+        out.write(reinterpret_cast<const char *>(base), static_cast<std::streamsize>(length));
+    }
+#endif
+}
+
+DenseQTable MappedModel::toDenseQTable() const {
+    DenseQTable Q(isCanonical());
+    for (uint32_t i = 0; i < size(); ++i) {
+        const uint32_t index = isCanonical() ? canonicalize(keys[i]).slot : keys[i];
+        std::copy(valuesAt(i), valuesAt(i) + boardCells, Q.row(index));
+    }
+    return Q;
+}
+
+const double *OverlayModel::find(const uint32_t state) const {
+    if (const auto it = updates.find(state); it != updates.end()) {
+        return it->second.data();
+    }
+    return model.find(state);
+}
+
+double *OverlayModel::update(const uint32_t state) {
+    const auto [it, inserted] = updates.try_emplace(state);
+    if (inserted) {
+        if (const double *q = model.find(state)) {
+            std::copy(q, q + boardCells, it->second.begin());
+        }
+    }
+    return it->second.data();
+}
+
+DenseQTable OverlayModel::toDenseQTable() const {
+    DenseQTable Q = model.toDenseQTable();
+    for (const auto &[state, values] : updates) {
+        std::copy(values.begin(), values.end(), Q.row(isCanonical() ? canonicalize(state).slot : state));
+    }
+    return Q;
+}
@@ -0,0 +1,53 @@
+#include <iostream>
+#include <string>
+#include "qtable.h"
+#include "model.h"
+
+// Convert models between the old text format and the binary format read by play.
+// usage: model_convert [--canonical] <input> <output>
+//   text input:   written as a binary model, --canonical folds symmetric states into one entry
+//   binary input: written as a text model
+int main(int argc, char **argv) {
+    bool canonical = false;
+    std::string paths[2];
+    int pathCount = 0;
+    for (int i = 1; i < argc; ++i) {
+        if (const std::string arg = argv[i]; arg == "--canonical") {
+            canonical = true;
+        } else if (pathCount < 2) {
+            paths[pathCount++] = arg;
+        } else {
+            pathCount = 3;
+        }
+    }
+    if (pathCount != 2) {
+        std::cerr << "usage: " << argv[0] << " [--canonical] <input> <output>\n";
+        return 1;
+    }
+    const auto &[input, output] = paths;
+
+    if (isBinaryModel(input)) {
+        MappedModel model;
+        if (!model.open(input)) {
+            return 1;
+        }
+        if (!saveQTable(model.toDenseQTable().toQTable(), output)) {
+            return 1;
+        }
+        std::cout << "Wrote " << model.size() << " states to text model " << output << "\n";
+        return 0;
+    }
+
+    const QTable Q = loadQTable(input);
+    if (Q.empty()) {
+        std::cerr << "Error: Q table is empty. Exiting.\n";
+        return 1;
+    }
+    DenseQTable dense(canonical);
+    dense.fromQTable(Q);
+    if (!writeModel(dense, output)) {
+        return 1;
+    }
+    std::cout << "Wrote " << dense.size() << " states to binary model " << output << "\n";
+    return 0;
+}
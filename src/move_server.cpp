@@ -0,0 +1,255 @@
+#include "move_server.h"
+
+#include <bit>
+#include <charconv>
+#include <string_view>
+#include "symmetry.h"
+#include "metrics.hpp"
+
+namespace {
+    const metrics::counter serverRequests("xoxo_server_requests_total", "Requests handled by the move server");
+    const metrics::counter serverMoves("xoxo_server_ai_moves_total", "AI moves played by the move server");
+    const metrics::counter serverGames("xoxo_server_games_total", "Games finished and learned from by the move server");
+    const metrics::gauge serverSessions("xoxo_server_sessions", "Open move server sessions");
+    const metrics::histogram batchSeconds("xoxo_server_batch_seconds", "Time to serve one batch of requests",
+                                          metrics::latency_buckets());
+
+    // split a request line into at most 4 space separated words, returns the number found
+    int splitWords(std::string_view line, std::string_view (&words)[4]) {
+        int count = 0;
+        while (count < 4) {
+            const auto start = line.find_first_not_of(" \t\r");
+            if (start == std::string_view::npos) {
+                break;
+            }
+            line.remove_prefix(start);
+            const auto end = line.find_first_of(" \t\r");
+            words[count++] = line.substr(0, end);
+            if (end == std::string_view::npos) {
+                break;
+            }
+            line.remove_prefix(end);
+        }
+        return count;
+    }
+
+    template <typename T>
+    bool parseNumber(const std::string_view word, T &value) {
+        const auto [end, error] = std::from_chars(word.data(), word.data() + word.size(), value);
+        return error == std::errc() && end == word.data() + word.size();
+    }
+
+    std::string resultOf(const int winner) {
+        return winner == 0 ? "x" : "o";
+    }
+}
+
+MoveServer::MoveServer(OverlayModel &model, const ServerConfig &config, Journal *journal)
+    : model(model), config(config), journal(journal), gen(config.seed != 0 ? config.seed : std::random_device{}())
+{
+}
+
+void MoveServer::handle(std::vector<ServerRequest> &batch) {
+    const metrics::scoped_timer timer(batchSeconds);
+    for (auto &request : batch) {
+        dispatch(request);
+    }
+    flush();
+    if (journal != nullptr) {
+        journal->flush();
+    }
+    serverRequests.inc(batch.size());
+    serverSessions.set(static_cast<double>(sessions.size()));
+}
+
+void MoveServer::dropClient(const uint32_t client) {
+    std::erase_if(sessions, [client](const auto &entry) { return entry.second.client == client; });
+    clientSessions.erase(client);
+    serverSessions.set(static_cast<double>(sessions.size()));
+}
+
+void MoveServer::endSession(const std::unordered_map<uint64_t, Session>::iterator it) {
+    if (const auto count = clientSessions.find(it->second.client); count != clientSessions.end() && --count->second == 0) {
+        clientSessions.erase(count);
+    }
+    sessions.erase(it);
+}
+
+void MoveServer::dispatch(ServerRequest &request) {
+    std::string_view words[4];
+    const int count = splitWords(request.line, words);
+    if (count == 0) {
+        request.reply = "error empty request";
+        return;
+    }
+    const auto command = words[0];
+
+    if (command == "new") {
+        signed char ai = 1;
+        if (count > 2 || (count == 2 && words[1] != "x" && words[1] != "o")) {
+            request.reply = "error usage: new [x|o]";
+            return;
+        }
+        if (count == 2 && words[1] == "o") {
+            ai = 0;
+        }
+        uint32_t &open = clientSessions[request.client];
+        if (open >= config.maxSessionsPerClient) {
+            request.reply = "error too many sessions";
+            return;
+        }
+        ++open;
+        const uint64_t id = nextId++;
+        Session &session = sessions[id];
+        session.client = request.client;
+        session.ai = ai;
+        if (ai == 0) {
+            // X moves first
+            session.pending = true;
+            pending.push_back({ &request, id, "ok " + std::to_string(id), false });
+        } else {
+            request.reply = "ok " + std::to_string(id);
+        }
+        return;
+    }
+
+    if (command == "stats") {
+        // count the AI moves queued before this request as played
+        flush();
+        request.reply = "stats sessions=" + std::to_string(sessions.size()) + " games=" + std::to_string(gameCount)
+            + " moves=" + std::to_string(moveCount);
+        return;
+    }
+
+    if (command != "move" && command != "close") {
+        request.reply = "error unknown command";
+        return;
+    }
+    uint64_t id = 0;
+    if (count < 2 || !parseNumber(words[1], id)) {
+        request.reply = "error missing session id";
+        return;
+    }
+    auto it = sessions.find(id);
+    if (it != sessions.end() && it->second.pending) {
+        // the client did not wait for the AI's answer, play it before going on
+        flush();
+        it = sessions.find(id);
+    }
+    if (it == sessions.end() || it->second.client != request.client) {
+        request.reply = "error unknown session";
+        return;
+    }
+    Session &session = it->second;
+
+    if (command == "close") {
+        endSession(it);
+        request.reply = "ok " + std::to_string(id);
+        return;
+    }
+
+    int x, y;
+    if (count != 4 || !parseNumber(words[2], x) || !parseNumber(words[3], y)) {
+        request.reply = "error usage: move <id> <x> <y>";
+        return;
+    }
+    if (x < 0 || x >= Board3x3::width || y < 0 || y >= Board3x3::height) {
+        request.reply = "error move out of range";
+        return;
+    }
+    const int cell = Board3x3::index_of(x, y);
+    if (session.board.at(cell) != -1) {
+        request.reply = "error cell is occupied";
+        return;
+    }
+
+    session.board.make_move(cell, static_cast<signed char>(1 - session.ai));
+    if (const auto result = finishIfOver(id, session, cell); result != "-") {
+        request.reply = "end " + std::to_string(id) + " " + result;
+        return;
+    }
+    session.pending = true;
+    pending.push_back({ &request, id, "ai " + std::to_string(id), true });
+}
+
+void MoveServer::flush() {
+    for (auto &move : pending) {
+        Session &session = sessions.at(move.id);
+        const Board3x3 &board = session.board;
+
+        // Canonical models are looked up with the canonical representative of the board (see
+        // symmetry.h), and their actions are in the frame of that representative.
+        uint32_t state = getStateIndex(static_cast<uint32_t>(board.stones(0)), static_cast<uint32_t>(board.stones(1)),
+                                       session.ai == 0 ? 'X' : 'O');
+        uint8_t transform = 0;
+        if (model.isCanonical()) {
+            const auto [slot, frame] = canonicalize(state);
+            state = canonicalStateIndex(slot);
+            transform = frame;
+        }
+        const uint32_t legalMoves = transformMask(static_cast<uint32_t>(board.empty_cells()), transform);
+
+        int action;
+        if (const double *q = model.find(state)) {
+            action = std::countr_zero(legalMoves);
+            for (uint32_t moves = legalMoves; moves; moves &= moves - 1) {
+                if (const int a = std::countr_zero(moves); q[a] > q[action]) {
+                    action = a;
+                }
+            }
+        } else {
+            // a board the model has never seen, pick the n-th legal move at random
+            std::uniform_int_distribution<> moveDis(0, std::popcount(legalMoves) - 1);
+            uint32_t moves = legalMoves;
+            for (int skip = moveDis(gen); skip > 0; --skip) {
+                moves &= moves - 1;
+            }
+            action = std::countr_zero(moves);
+        }
+
+        const int cell = inverseTransformCell(action, transform);
+        session.board.make_move(cell, session.ai);
+        session.history[session.aiMoves++] = { state, static_cast<uint8_t>(action) };
+        session.pending = false;
+        ++moveCount;
+
+        move.request->reply = move.prefix + " " + std::to_string(cell % Board3x3::width) + " "
+            + std::to_string(cell / Board3x3::width);
+        if (move.withResult) {
+            move.request->reply += " " + finishIfOver(move.id, session, cell);
+        }
+    }
+    serverMoves.inc(pending.size());
+    pending.clear();
+}
+
+std::string MoveServer::finishIfOver(const uint64_t id, Session &session, const int cell) {
+    std::string result = "-";
+    if (const int winner = session.board.check_win(cell); winner != -1) {
+        learn(session, winner == session.ai ? 1.0 : -1.0);
+        result = resultOf(winner);
+    } else if (session.board.full()) {
+        learn(session, 0.0);
+        result = "draw";
+    } else {
+        return result;
+    }
+    endSession(sessions.find(id));
+    return result;
+}
+
+void MoveServer::learn(const Session &session, const double reward) {
+    // Update the Q-values of the AI's moves in reverse order, in the updates of the shared model.
+    double target = reward;
+    for (int i = session.aiMoves - 1; i >= 0; --i) {
+        const auto [state, action] = session.history[i];
+        double &q = model.update(state)[action];
+        q += config.alpha * (target - q);
+        if (journal != nullptr) {
+            journal->append(state, action, q);
+        }
+        target *= config.discount;
+    }
+    ++gameCount;
+    serverGames.inc();
+}
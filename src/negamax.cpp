@@ -0,0 +1,216 @@
+#include "negamax.h"
+
+#include <algorithm>
+#include <limits>
+#include "symmetry.h"
+
+namespace {
+    constexpr int infinity = std::numeric_limits<int16_t>::max();
+    // xored into the board hash when O is to move
+    constexpr uint64_t sideKey = 0x9e3779b97f4a7c15ULL;
+}
+
+Solver::Solver(Space &game, const unsigned int tableBits)
+    : game(game), width(game.get_width()), cells(game.get_width() * game.get_height()),
+      table(uint64_t{1} << tableBits), tableMask((uint64_t{1} << tableBits) - 1)
+{
+    // cells that lie on more lines of win_length take part in more threats, search them first
+    const int height = static_cast<int>(game.get_height());
+    const int k = static_cast<int>(game.get_win_length());
+    std::vector<int> lines(cells, 0);
+    for (const auto &[dx, dy] : { std::pair{1, 0}, std::pair{0, 1}, std::pair{1, 1}, std::pair{-1, 1} }) {
+        for (int y = 0; y < height; ++y) {
+            for (int x = 0; x < static_cast<int>(width); ++x) {
+                const int endX = x + dx * (k - 1), endY = y + dy * (k - 1);
+                if (endX < 0 || endX >= static_cast<int>(width) || endY >= height) {
+                    continue;
+                }
+                for (int step = 0; step < k; ++step) {
+                    ++lines[(y + dy * step) * width + x + dx * step];
+                }
+            }
+        }
+    }
+    cellOrder.resize(cells);
+    for (int cell = 0; cell < static_cast<int>(cells); ++cell) {
+        cellOrder[cell] = cell;
+    }
+    std::ranges::stable_sort(cellOrder, [&](const int a, const int b) { return lines[a] > lines[b]; });
+}
+
+void Solver::clear() {
+    std::ranges::fill(table, Entry{});
+}
+
+void Solver::play(const int cell, const signed char player) {
+    game.make_move(cell % width, cell / width, player);
+    --empties;
+}
+
+void Solver::undo(const int cell, const signed char player) {
+    game.unmake_move(cell % width, cell / width, player);
+    ++empties;
+}
+
+uint64_t Solver::key(const signed char player) const {
+    return game.hash() ^ (player == 1 ? sideKey : 0);
+}
+
+bool Solver::wins(const int cell, const signed char player) {
+    const int x = cell % width, y = cell / width;
+    game.make_move(x, y, player);
+    const bool won = game.check_win(x, y) == player;
+    game.unmake_move(x, y, player);
+    return won;
+}
+
+void Solver::countEmpties() {
+    empties = static_cast<int>(game.empty_cells().count());
+}
+
+int Solver::negamax(const signed char player, int alpha, int beta) {
+    ++nodeCount;
+    const Bitboard free = game.empty_cells();
+
+    // a win now is the best any move can do
+    for (const int cell : cellOrder) {
+        if (free.test(cell) && wins(cell, player)) {
+            return empties;
+        }
+    }
+    // the last stone did not win, so the board fills up drawn
+    if (empties <= 1) {
+        return 0;
+    }
+
+    // Without an immediate win the player wins at best with its next stone, and loses at worst
+    // to the opponent's next stone.
+    alpha = std::max(alpha, -(empties - 1));
+    beta = std::min(beta, empties - 2);
+    if (alpha >= beta) {
+        return alpha;
+    }
+
+    const int alphaBefore = alpha;
+    const uint64_t hash = key(player);
+    Entry &entry = table[hash & tableMask];
+    int tableMove = -1;
+    if (entry.key == hash && entry.bound != Bound::none) {
+        if (entry.bound == Bound::exact) {
+            return entry.score;
+        }
+        if (entry.bound == Bound::lower) {
+            alpha = std::max<int>(alpha, entry.score);
+        } else {
+            beta = std::min<int>(beta, entry.score);
+        }
+        if (alpha >= beta) {
+            return entry.score;
+        }
+        tableMove = entry.move;
+    }
+
+    int best = -infinity;
+    int bestCell = -1;
+    auto search = [&](const int cell) {
+        play(cell, player);
+        const int score = -negamax(static_cast<signed char>(1 - player), -beta, -alpha);
+        undo(cell, player);
+        if (score > best) {
+            best = score;
+            bestCell = cell;
+        }
+        alpha = std::max(alpha, score);
+        return alpha >= beta;
+    };
+
+    if (tableMove < 0 || !search(tableMove)) {
+        for (const int cell : cellOrder) {
+            if (cell != tableMove && free.test(cell) && search(cell)) {
+                break;
+            }
+        }
+    }
+
+    // always replace, the newest result is the most likely to be needed again
+    entry.key = hash;
+    entry.move = bestCell;
+    entry.score = static_cast<int16_t>(best);
+    entry.bound = best <= alphaBefore ? Bound::upper : best >= beta ? Bound::lower : Bound::exact;
+    return best;
+}
+
+int Solver::solve(const signed char player) {
+    countEmpties();
+    if (empties == 0) {
+        return 0;
+    }
+    return negamax(player, -infinity, infinity);
+}
+
+int Solver::solveMove(const int cell, const signed char player) {
+    countEmpties();
+    const int before = empties;
+    if (wins(cell, player)) {
+        ++nodeCount;
+        return before;
+    }
+    play(cell, player);
+    const int score = empties == 0 ? 0 : -negamax(static_cast<signed char>(1 - player), -infinity, infinity);
+    undo(cell, player);
+    return score;
+}
+
+int Solver::bestMove(const signed char player) {
+    int best = -infinity;
+    int bestCell = -1;
+    const Bitboard free = game.empty_cells();
+    for (const int cell : cellOrder) {
+        if (!free.test(cell)) {
+            continue;
+        }
+        if (const int score = solveMove(cell, player); score > best) {
+            best = score;
+            bestCell = cell;
+        }
+    }
+    return bestCell;
+}
+
+DenseQTable solvedQTable(const bool canonical, uint64_t *nodes) {
+    DenseQTable Q(canonical);
+    Space game;
+    Solver solver(game, 16);
+
+    for (uint32_t index = 0; index < Q.rowCount(); ++index) {
+        const uint32_t state = canonical ? canonicalStateIndex(index) : index;
+
+        // state = 2 * board + side to move, board holds one base-3 digit (0 empty, 1 X, 2 O) per cell
+        int stones[2] = {0, 0};
+        uint32_t board = state >> 1;
+        for (uint32_t cell = 0; cell < boardCells; ++cell, board /= 3) {
+            const auto digit = static_cast<signed char>(board % 3);
+            game.place(static_cast<int>(cell % 3), static_cast<int>(cell / 3), static_cast<signed char>(digit - 1));
+            if (digit != 0) {
+                ++stones[digit - 1];
+            }
+        }
+
+        // X moves first, so only boards with as many Xs as Os (X to move) or one more X (O to move)
+        // come up in a game, and only while nobody has won
+        const auto player = static_cast<signed char>(state & 1);
+        if (stones[0] - stones[1] != player || stones[0] + stones[1] == boardCells || game.check_win() != -1) {
+            continue;
+        }
+
+        double *q = Q.row(index);
+        for (const int cell : getLegalMoves(game)) {
+            q[cell] = solver.solveMove(cell, player) / static_cast<double>(boardCells + 1);
+        }
+    }
+
+    if (nodes != nullptr) {
+        *nodes = solver.nodes();
+    }
+    return Q;
+}
@@ -1,103 +1,128 @@
 #include <iostream>
-#include <fstream>
 #include <unordered_map>
 #include <vector>
-#include <string>
-#include <sstream>
+#include <array>
+#include <algorithm>
+#include <utility>
 #include <random>
-#include <tuple>
+#include <string>
+#include <cstdlib>
+#include <chrono>
+#include <optional>
 #include "space.h"
-
-// Type alias for Q-table.
-using QTable = std::unordered_map<std::string, std::vector<double>>;
+#include "qtable.h"
+#include "symmetry.h"
+#include "model.h"
+#include "journal.h"
+#include "mcts.h"
+#include "metrics.hpp"
+#ifdef PLAY_EMBEDDED_POLICY
+// generated by gen_policy at build time, see CMakeLists.txt
+# include "embedded_policy.h"
+#endif
 
 // Q-learning hyperparameters.
 const double alpha = 0.1;
-const double gamma = 0.9;
-
-// Encode the current board state and current player into a key.
-// Board cells are encoded as '-' for empty, 'X' for 0, and 'O' for 1, then appended by the current player's char.
-std::string getStateKey(const Space &game, char currentPlayer) {
-    std::string key;
-    key.reserve(10); // 9 board cells + 1 player char.
-    for (int y = 0; y < 3; ++y) {
-        for (int x = 0; x < 3; ++x) {
-            signed char cell = game.get(x, y);
-            if (cell == -1)
-                key.push_back('-');
-            else if (cell == 0)
-                key.push_back('X');
-            else if (cell == 1)
-                key.push_back('O');
-        }
-    }
-    key.push_back(currentPlayer);
-    return key;
-}
+const double discount = 0.9;  // gamma, named so it does not clash with ::gamma() from <cmath>
 
-// Returns a list of legal moves (cell indices) on the board.
-std::vector<int> getLegalMoves(const Space &game) {
-    std::vector<int> moves;
-    moves.reserve(9);
-    for (int y = 0; y < 3; ++y) {
-        for (int x = 0; x < 3; ++x) {
-            if (game.get(x, y) == -1)
-                moves.push_back(y * 3 + x);
-        }
-    }
-    return moves;
-}
+// Journal records (Q-updates) after which the journal is folded into ai_model.dat.
+const uint64_t compactAfter = 4096;
 
-// Loads the Q-table from a file.
-QTable loadQTable(const std::string &filename) {
-    QTable Q;
-    std::ifstream in(filename);
-    if (!in) {
-        std::cerr << "Error: failed to open " << filename << "\n";
-        return Q;
-    }
-    std::string line;
-    while (std::getline(in, line)) {
-        std::istringstream iss(line);
-        std::string state;
-        iss >> state;
-        std::vector<double> values;
-        double val;
-        while (iss >> val) {
-            values.push_back(val);
-        }
-        Q[state] = values;
+// The play_embedded build plays the policy compiled into the binary: it reads no model file and
+// learns nothing, the policy only changes with a rebuild.
+#ifdef PLAY_EMBEDDED_POLICY
+constexpr bool embeddedPolicy = true;
+#else
+constexpr bool embeddedPolicy = false;
+#endif
+
+namespace {
+    const metrics::counter modelLookups("xoxo_play_lookups_total", "Model lookups for an AI move");
+    const metrics::counter modelMisses("xoxo_play_lookup_misses_total", "AI moves chosen at random because the model has no entry");
+    const metrics::counter mctsPlayouts("xoxo_play_mcts_playouts_total", "Playouts searched for AI moves");
+    const metrics::counter gamesPlayed("xoxo_play_games_total", "Games finished");
+    const metrics::histogram moveSeconds("xoxo_play_move_seconds", "Time to choose an AI move", metrics::latency_buckets());
+
+    void printUsage(const char *program) {
+        std::cerr << "usage: " << program << " [options]\n"
+                  << "  --width <n>               board width (default 3)\n"
+                  << "  --height <n>              board height (default 3)\n"
+                  << "  --win <n>                 stones in a row needed to win (default 3)\n"
+                  << "  --mcts                    play with tree search instead of ai_model.dat,\n"
+                  << "                            always on for boards other than 3x3 with 3 in a row\n"
+                  << "  --seconds <x>             search time per move (default 1)\n"
+                  << "  --playouts <n>            playouts per move, 0 for no limit (default 0)\n"
+                  << "  --threads <n>             search threads, 0 for one per hardware thread (default 0)\n"
+                  << "  --metrics <file>          write metrics in Prometheus text format to this file\n";
     }
-    return Q;
 }
 
-// Saves the Q-table to a file.
-void saveQTable(const QTable &Q, const std::string &filename) {
-    std::ofstream out(filename);
-    if (!out) {
-        std::cerr << "Error: failed to open " << filename << " for writing.\n";
-        return;
-    }
-    for (const auto &entry : Q) {
-        out << entry.first;
-        for (double qVal : entry.second) {
-            out << " " << qVal;
+int main(int argc, char **argv) {
+    int width = 3, height = 3, winLength = 3;
+    bool useMcts = false;
+    MctsConfig mctsConfig;
+    std::string metricsPath;
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        const bool hasValue = i + 1 < argc;
+        if (arg == "--width" && hasValue) {
+            width = std::atoi(argv[++i]);
+        } else if (arg == "--height" && hasValue) {
+            height = std::atoi(argv[++i]);
+        } else if (arg == "--win" && hasValue) {
+            winLength = std::atoi(argv[++i]);
+        } else if (arg == "--mcts") {
+            useMcts = true;
+        } else if (arg == "--seconds" && hasValue) {
+            mctsConfig.seconds = std::strtod(argv[++i], nullptr);
+        } else if (arg == "--playouts" && hasValue) {
+            mctsConfig.playouts = std::strtoull(argv[++i], nullptr, 10);
+        } else if (arg == "--threads" && hasValue) {
+            mctsConfig.threads = std::strtoul(argv[++i], nullptr, 10);
+        } else if (arg == "--metrics" && hasValue) {
+            metricsPath = argv[++i];
+        } else {
+            printUsage(argv[0]);
+            return 1;
         }
-        out << "\n";
     }
-    out.close();
-}
-
-int main() {
-    // Load the pre-trained Q-table.
-    QTable Q = loadQTable("ai_model.dat");
-    if (Q.empty()) {
-        std::cerr << "Error: Q table is empty. Exiting.\n";
+    // The Q-table only knows the 3x3 game.
+    useMcts = useMcts || width != 3 || height != 3 || winLength != 3;
+    if (useMcts && mctsConfig.seconds <= 0 && mctsConfig.playouts == 0) {
+        std::cerr << "Error: --seconds or --playouts has to limit the search.\n";
         return 1;
     }
 
     Space game;
-    game.resize(3, 3);
+    try {
+        game = Space(width, height, winLength);
+    } catch (std::exception &e) {
+        std::cerr << "Error: " << e.what() << "\n";
+        return 1;
+    }
+
+    // Map the pre-trained model and lay the updates of earlier games from its journal over it,
+    // states are looked up in place. What this game teaches is appended to the journal, the
+    // model file itself is only rewritten by compaction.
+    OverlayModel model;
+    Journal journal;
+    if (!useMcts && !embeddedPolicy) {
+        if (!model.open("ai_model.dat") || model.base().size() == 0) {
+            std::cerr << "Error: Q table is empty. Exiting.\n";
+            return 1;
+        }
+        if (!journal.open("ai_model.dat", model)) {
+            return 1;
+        }
+    }
+    // the search tree's node pool is large, only allocate it when the AI searches
+    std::optional<Mcts> mcts;
+    if (useMcts) {
+        mcts.emplace(mctsConfig);
+    }
+    if (!metricsPath.empty()) {
+        metrics::start_periodic_dump(metricsPath, std::chrono::seconds(5));
+    }
 
     std::cout << "Welcome to XXO! You are X and the AI is O.\n";
     game.print();
@@ -107,12 +132,28 @@ int main() {
     std::mt19937 gen(rd());
 
     // Record only AI's moves for online learning.
-    std::vector<std::tuple<std::string, int>> aiHistory;
+    std::vector<std::pair<uint32_t, int>> aiHistory;
+
+    // Update the Q-values for the AI's moves in reverse order.
+    auto learnFromGame = [&](const double reward) {
+        if (useMcts || embeddedPolicy) {
+            return;
+        }
+        double target = reward;
+        for (auto it = aiHistory.rbegin(); it != aiHistory.rend(); ++it) {
+            const auto [s, a] = *it;
+            double &q = model.update(s)[a];
+            q += alpha * (target - q);
+            journal.append(s, a, q);
+            target *= discount;
+        }
+    };
 
     while (true) {
+        // Coordinates of the move made this turn.
+        int x, y;
         if (currentPlayer == 'X') {
             // Human's turn.
-            int x, y;
             std::cout << "Enter your move (x y): ";
             std::cin >> x >> y;
             try {
@@ -125,38 +166,83 @@ int main() {
                 std::cout << e.what() << "\n";
                 continue;
             }
+        } else if (useMcts) {
+            // AI's turn, searched on the current board.
+            const metrics::scoped_timer timer(moveSeconds);
+            const MctsResult result = mcts->search(game, 1);
+            mctsPlayouts.inc(result.playouts);
+            x = result.move % width;
+            y = result.move / width;
+            game.place(x, y, 1);  // O is represented by 1.
+            std::cout << "AI placed an O at (" << x << ", " << y << ") after " << result.playouts << " playouts in "
+                      << result.seconds << " s (" << result.playoutsPerSecond() << " playouts/sec)\n";
+#ifdef PLAY_EMBEDDED_POLICY
+        } else {
+            // AI's turn, one load from the compiled-in table.
+            const metrics::scoped_timer timer(moveSeconds);
+            modelLookups.inc();
+            int cell = embedded_policy::bestAction[getStateIndex(game, 'O')];
+            if (cell < 0) {
+                // If the model never saw the state, choose a random legal move.
+                modelMisses.inc();
+                const auto legalMoves = getLegalMoves(game);
+                std::uniform_int_distribution<> moveDis(0, legalMoves.size() - 1);
+                cell = legalMoves[moveDis(gen)];
+            }
+            x = cell % 3;
+            y = cell / 3;
+            game.place(x, y, 1);  // O is represented by 1.
+            std::cout << "AI placed an O at (" << x << ", " << y << ")\n";
+        }
+#else
         } else {
             // AI's turn.
-            std::string state = getStateKey(game, 'O');
+            const metrics::scoped_timer timer(moveSeconds);
+            // Canonical models are looked up with the canonical representative of the board
+            // (see symmetry.h), and their actions are in the frame of that representative.
+            uint32_t state = getStateIndex(game, 'O');
+            uint8_t frame = 0;
+            if (model.isCanonical()) {
+                const auto [slot, transform] = canonicalize(state);
+                state = canonicalStateIndex(slot);
+                frame = transform;
+            }
             auto legalMoves = getLegalMoves(game);
+            for (int &a : legalMoves) {
+                a = transformCell(a, frame);
+            }
             int action = -1;
-            if (Q.find(state) != Q.end()) {
+            modelLookups.inc();
+            if (const double *q = model.find(state)) {
                 double bestValue = -1e9;
                 int bestAction = legalMoves[0];
                 for (int a : legalMoves) {
-                    if (Q[state][a] > bestValue) {
-                        bestValue = Q[state][a];
+                    if (q[a] > bestValue) {
+                        bestValue = q[a];
                         bestAction = a;
                     }
                 }
                 action = bestAction;
             } else {
                 // If state not seen, choose a random legal move.
+                modelMisses.inc();
                 std::uniform_int_distribution<> moveDis(0, legalMoves.size() - 1);
                 action = legalMoves[moveDis(gen)];
             }
             // Record the AI's move for later learning.
             aiHistory.emplace_back(state, action);
 
-            int x = action % 3;
-            int y = action / 3;
+            const int cell = inverseTransformCell(action, frame);
+            x = cell % 3;
+            y = cell / 3;
             game.place(x, y, 1);  // O is represented by 1.
             std::cout << "AI placed an O at (" << x << ", " << y << ")\n";
         }
+#endif
 
         game.print();
 
-        int result = game.check_win();  // 0 for X win, 1 for O win, -1 for no win.
+        int result = game.check_win(x, y);  // 0 for X win, 1 for O win, -1 for no win.
         if (result != -1) {
             if (result == 0)
                 std::cout << "X wins!\n";
@@ -165,37 +251,14 @@ int main() {
 
             // Determine reward from AI's perspective.
             // AI win: reward = 1, loss: reward = -1.
-            double reward = (result == 1) ? 1.0 : -1.0;
-            double target = reward;
-            // Update the Q-values for the AI's moves in reverse order.
-            for (int i = static_cast<int>(aiHistory.size()) - 1; i >= 0; --i) {
-                std::string s;
-                int a;
-                std::tie(s, a) = aiHistory[i];
-                if (Q.find(s) == Q.end()) {
-                    Q[s] = std::vector<double>(9, 0.0);
-                }
-                Q[s][a] += alpha * (target - Q[s][a]);
-                target *= gamma;
-            }
+            learnFromGame((result == 1) ? 1.0 : -1.0);
             break;
         }
 
         // Check for a draw.
-        if (getLegalMoves(game).empty()) {
+        if (!game.empty_cells().any()) {
             std::cout << "It's a draw!\n";
-            double reward = 0.0;
-            double target = reward;
-            for (int i = static_cast<int>(aiHistory.size()) - 1; i >= 0; --i) {
-                std::string s;
-                int a;
-                std::tie(s, a) = aiHistory[i];
-                if (Q.find(s) == Q.end()) {
-                    Q[s] = std::vector<double>(9, 0.0);
-                }
-                Q[s][a] += alpha * (target - Q[s][a]);
-                target *= gamma;
-            }
+            learnFromGame(0.0);
             break;
         }
 
@@ -203,8 +266,21 @@ int main() {
         currentPlayer = (currentPlayer == 'X') ? 'O' : 'X';
     }
 
-    // Save the updated Q-table back to file.
-    saveQTable(Q, "ai_model.dat");
+    gamesPlayed.inc();
+    metrics::stop_periodic_dump();
+
+    // Persist what the game taught: a few appends to the journal. Once enough games have piled
+    // up there, fold them into the model so startup does not replay an ever longer journal.
+    if (useMcts || embeddedPolicy) {
+        std::cout << "Game over.\n";
+        return 0;
+    }
+    if (!journal.flush()) {
+        return 1;
+    }
+    if (journal.records() >= compactAfter && !journal.compact(model, "ai_model.dat", true)) {
+        return 1;
+    }
     std::cout << "Game over. The AI has updated its knowledge from the game.\n";
 
     return 0;
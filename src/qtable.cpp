@@ -0,0 +1,179 @@
+#include "qtable.h"
+#include "symmetry.h"
+
+#include <algorithm>
+#include <array>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+namespace {
+    // base3[mask] is the base-3 number with digit 1 at every set bit of a 9-bit mask,
+    // so a board is base3[X stones] + 2 * base3[O stones]
+    constexpr auto base3 = [] {
+        std::array<uint32_t, 1 << boardCells> table{};
+        for (uint32_t mask = 0; mask < table.size(); ++mask) {
+            uint32_t value = 0;
+            for (int cell = boardCells - 1; cell >= 0; --cell) {
+                value = value * 3 + ((mask >> cell) & 1);
+            }
+            table[mask] = value;
+        }
+        return table;
+    }();
+}
+
+uint32_t getStateIndex(const Space &game, const char currentPlayer) {
+    return getStateIndex(static_cast<uint32_t>(game.stones(0).word(0)), static_cast<uint32_t>(game.stones(1).word(0)),
+                         currentPlayer);
+}
+
+uint32_t getStateIndex(const uint32_t xStones, const uint32_t oStones, const char currentPlayer) {
+    const auto board = base3[xStones] + 2 * base3[oStones];
+    return board * 2 + (currentPlayer == 'X' ? 0 : 1);
+}
+
+std::string getStateKey(const Space &game, const char currentPlayer) {
+    std::string key(boardCells, '-');
+    game.stones(0).for_each([&](const uint64_t cell) { key[cell] = 'X'; });
+    game.stones(1).for_each([&](const uint64_t cell) { key[cell] = 'O'; });
+    key.push_back(currentPlayer);
+    return key;
+}
+
+std::string stateKeyOf(uint32_t state) {
+    std::string key(boardCells + 1, '-');
+    key[boardCells] = (state & 1) ? 'O' : 'X';
+    state >>= 1;
+    for (uint32_t cell = 0; cell < boardCells; ++cell, state /= 3) {
+        if (const auto digit = state % 3; digit == 1)
+            key[cell] = 'X';
+        else if (digit == 2)
+            key[cell] = 'O';
+    }
+    return key;
+}
+
+bool parseStateKey(const std::string &key, uint32_t &state) {
+    if (key.size() != boardCells + 1 || (key[boardCells] != 'X' && key[boardCells] != 'O')) {
+        return false;
+    }
+
+    uint32_t board = 0;
+    for (int cell = boardCells - 1; cell >= 0; --cell) {
+        uint32_t digit;
+        switch (key[cell]) {
+            case '-': digit = 0; break;
+            case 'X': digit = 1; break;
+            case 'O': digit = 2; break;
+            default: return false;
+        }
+        board = board * 3 + digit;
+    }
+    state = board * 2 + (key[boardCells] == 'X' ? 0 : 1);
+    return true;
+}
+
+uint32_t getLegalMoveMask(const Space &game) {
+    return static_cast<uint32_t>(game.empty_cells().word(0));
+}
+
+std::vector<int> getLegalMoves(const Space &game) {
+    std::vector<int> moves;
+    moves.reserve(boardCells);
+    game.empty_cells().for_each([&](const uint64_t cell) { moves.push_back(static_cast<int>(cell)); });
+    return moves;
+}
+
+DenseQTable::DenseQTable(const bool canonical)
+    : canonical(canonical), rows(canonical ? canonicalStateCount : stateCount),
+      values(static_cast<uint64_t>(rows) * boardCells, 0.0), visited(rows, 0)
+{
+}
+
+DenseQTable DenseQTable::sharedSnapshot() const {
+    DenseQTable copy(canonical);
+    for (uint32_t index = 0; index < rows; ++index) {
+        if (!std::atomic_ref(const_cast<uint8_t &>(visited[index])).load(std::memory_order_relaxed)) {
+            continue;
+        }
+        double *q = copy.row(index);
+        for (uint32_t a = 0; a < boardCells; ++a) {
+            q[a] = loadShared(index, a);
+        }
+    }
+    return copy;
+}
+
+std::string DenseQTable::keyOf(const uint32_t index) const {
+    return stateKeyOf(canonical ? canonicalStateIndex(index) : index);
+}
+
+QTable DenseQTable::toQTable() const {
+    QTable Q;
+    Q.reserve(visitedCount);
+    for (uint32_t index = 0; index < rows; ++index) {
+        if (visited[index]) {
+            const double *q = row(index);
+            Q.emplace(keyOf(index), std::vector<double>(q, q + boardCells));
+        }
+    }
+    return Q;
+}
+
+void DenseQTable::fromQTable(const QTable &Q) {
+    for (const auto &[key, qvals] : Q) {
+        uint32_t state;
+        if (!parseStateKey(key, state) || qvals.size() != boardCells) {
+            continue;
+        }
+        if (!canonical) {
+            std::copy(qvals.begin(), qvals.end(), row(state));
+            continue;
+        }
+        const auto [slot, transform] = canonicalize(state);
+        double *q = row(slot);
+        for (uint32_t a = 0; a < boardCells; ++a) {
+            q[transformCell(static_cast<int>(a), transform)] = qvals[a];
+        }
+    }
+}
+
+QTable loadQTable(const std::string &filename) {
+    QTable Q;
+    std::ifstream in(filename);
+    if (!in) {
+        std::cerr << "Error: failed to open " << filename << "\n";
+        return Q;
+    }
+    std::string line;
+    while (std::getline(in, line)) {
+        std::istringstream iss(line);
+        std::string state;
+        iss >> state;
+        std::vector<double> values;
+        double val;
+        while (iss >> val) {
+            values.push_back(val);
+        }
+        Q[state] = values;
+    }
+    return Q;
+}
+
+bool saveQTable(const QTable &Q, const std::string &filename) {
+    std::ofstream out(filename);
+    if (!out) {
+        std::cerr << "Error: failed to open " << filename << " for writing.\n";
+        return false;
+    }
+    for (const auto &entry : Q) {
+        out << entry.first;
+        for (double qVal : entry.second) {
+            out << " " << qVal;
+        }
+        out << "\n";
+    }
+    out.close();
+    return static_cast<bool>(out);
+}
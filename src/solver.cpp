@@ -0,0 +1,92 @@
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <cstdlib>
+#include "space.h"
+#include "negamax.h"
+#include "model.h"
+
+namespace {
+    void printUsage(const char *program) {
+        std::cerr << "usage: " << program << " [options]\n"
+                  << "  --width <n>               board width (default 3)\n"
+                  << "  --height <n>              board height (default 3)\n"
+                  << "  --win <n>                 stones in a row needed to win (default 3)\n"
+                  << "  --table-bits <n>          log2 of the transposition table entries (default 22)\n"
+                  << "  --output <file>           model written for the 3x3 game (default ai_model.dat)\n"
+                  << "  --no-symmetry             write every rotation and reflection of a board separately\n";
+    }
+
+    const char *outcome(const int score) {
+        return score > 0 ? "wins" : score < 0 ? "loses" : "draws";
+    }
+}
+
+// Solve k-in-a-row exactly. On the 3x3 board with 3 in a row it writes the perfect-play Q-table as
+// a binary model that play loads like a trained one; other boards only report the value of the
+// empty board and the best first move.
+int main(int argc, char **argv) {
+    int width = 3, height = 3, winLength = 3;
+    unsigned int tableBits = 22;
+    std::string output = "ai_model.dat";
+    bool canonical = true;
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        const bool hasValue = i + 1 < argc;
+        if (arg == "--width" && hasValue) {
+            width = std::atoi(argv[++i]);
+        } else if (arg == "--height" && hasValue) {
+            height = std::atoi(argv[++i]);
+        } else if (arg == "--win" && hasValue) {
+            winLength = std::atoi(argv[++i]);
+        } else if (arg == "--table-bits" && hasValue) {
+            tableBits = std::strtoul(argv[++i], nullptr, 10);
+        } else if (arg == "--output" && hasValue) {
+            output = argv[++i];
+        } else if (arg == "--no-symmetry") {
+            canonical = false;
+        } else {
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+    auto elapsed = [&] {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    };
+
+    if (width == 3 && height == 3 && winLength == 3) {
+        uint64_t nodes = 0;
+        const DenseQTable Q = solvedQTable(canonical, &nodes);
+        const double seconds = elapsed();
+        std::cout << "Solved " << Q.size() << " states, " << nodes << " nodes in " << seconds << " s ("
+                  << static_cast<double>(nodes) / seconds << " nodes/sec)\n";
+        if (!writeModel(Q, output)) {
+            return 1;
+        }
+        std::cout << "Perfect-play Q table saved to " << output << "\n";
+        return 0;
+    }
+
+    Space game;
+    try {
+        game = Space(width, height, winLength);
+    } catch (std::exception &e) {
+        std::cerr << "Error: " << e.what() << "\n";
+        return 1;
+    }
+    if (tableBits > 32) {
+        std::cerr << "Error: --table-bits must be at most 32\n";
+        return 1;
+    }
+    Solver solver(game, tableBits);
+    const int score = solver.solve(0);
+    const int move = solver.bestMove(0);
+    const double seconds = elapsed();
+    std::cout << width << "x" << height << ", " << winLength << " in a row: X " << outcome(score)
+              << " (score " << score << "), best first move (" << move % width << ", " << move / width << ")\n"
+              << solver.nodes() << " nodes in " << seconds << " s ("
+              << static_cast<double>(solver.nodes()) / seconds << " nodes/sec)\n";
+    return 0;
+}
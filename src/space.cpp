@@ -3,81 +3,116 @@
 #include <iostream>
 #include <stdexcept>
 #include <sstream>
-#include <algorithm>    // for std::fill and std::swap
-#include <cstring>      // for std::memcpy
 
-void Space::resize(int new_width, int new_height)
+void Space::resize(const int new_width, const int new_height)
 {
     if (new_height < 3 || new_width < 3) {
         throw std::invalid_argument("Invalid size");
     }
 
-    // Swap new_width and new_height using std::swap instead of arithmetic swapping.
-    std::swap(new_width, new_height);
-
-    // Resize the desk: new_width becomes the number of rows, new_height the number of columns.
-    desk.resize(new_width);
-    for (auto & row : desk) {
-        row.resize(new_height);
-    }
-
-    // If the previous board had fewer columns, fill the new parts with -1.
-    if (width && width < new_width) {
-        for (auto & row : desk) {
-            // Start filling at index "width" (instead of width-1) for clarity.
-            std::fill(row.begin() + static_cast<size_t>(width), row.end(), -1);
-        }
-    }
-
-    // If the previous board had fewer rows, fill the new rows with -1.
-    if (height && height < new_height) {
-        for (auto it = desk.begin() + static_cast<size_t>(height); it < desk.end(); ++it) {
-            std::ranges::fill(*it, -1);
-        }
+    // Re-pack every stone that still fits into the new row stride.
+    Bitboard resized[2] { Bitboard(new_width * new_height), Bitboard(new_width * new_height) };
+    const auto keep_width = std::min<uint64_t>(width, new_width);
+    const auto keep_height = std::min<uint64_t>(height, new_height);
+    for (signed char player = 0; player < 2; ++player)
+    {
+        stones_of[player].for_each([&](const uint64_t index) {
+            const auto x = index % width;
+            const auto y = index / width;
+            if (x < keep_width && y < keep_height) {
+                resized[player].set(y * new_width + x);
+            } else {
+                // the stone falls off the board, and out of the hash
+                zobrist_hash ^= zobrist_key(static_cast<int>(x), static_cast<int>(y), player);
+            }
+        });
     }
 
-    // Swap back so that new_width becomes width and new_height becomes height.
-    std::swap(new_width, new_height);
+    stones_of[0] = std::move(resized[0]);
+    stones_of[1] = std::move(resized[1]);
     width = new_width;
     height = new_height;
+    build_line_masks();
 }
 
 Space::Space()
 {
     resize(3, 3);
-    for (auto & row : desk) {
-        for (auto & point : row) {
-            point = -1;
-        }
+}
+
+Space::Space(const int new_width, const int new_height, const int new_win_length)
+{
+    set_win_length(new_win_length);
+    resize(new_width, new_height);
+}
+
+void Space::set_win_length(const int new_win_length)
+{
+    if (new_win_length < 1) {
+        throw std::invalid_argument("Invalid win length");
     }
+
+    win_length = new_win_length;
+    build_line_masks();
 }
 
-void Space::place(const int x, const int y, const signed char c)
+void Space::build_line_masks()
 {
-    if (x >= 0 && x < width && y >= 0 && y < height) {
-        desk[y][x] = c;
-    } else {
-        throw std::out_of_range("Placement out of range");
+    const int reach = static_cast<int>(win_length) - 1;
+
+    for (int d = 0; d < 4; ++d)
+    {
+        const auto [dx, dy] = line_direction[d];
+        line_shift[d] = dy * width + dx;
+        line_starts[d].resize(width * height);
+        for (int y = 0; y < static_cast<int>(height); ++y) {
+            for (int x = 0; x < static_cast<int>(width); ++x) {
+                if (in_range(x + dx * reach, y + dy * reach)) {
+                    line_starts[d].set(index_of(x, y));
+                }
+            }
+        }
     }
 }
 
-signed char Space::get(const int x, const int y) const {
-    if (x >= 0 && x < width && y >= 0 && y < height) {
-        return desk[y][x];
-    } else {
-        throw std::out_of_range("Index out of range");
+bool Space::has_line(const Bitboard & board) const
+{
+    if (board.count() < win_length) {
+        return false;
+    }
+
+    Bitboard run;
+    for (int d = 0; d < 4; ++d)
+    {
+        // After the loop bit i survives only if bits i, i + shift, ..., i + (win_length - 1) * shift
+        // are all set. Runs are doubled each pass, so this takes log2(win_length) passes.
+        run = board;
+        uint64_t covered = 1;
+        while (covered < win_length) {
+            const auto step = std::min(covered, win_length - covered);
+            run.and_shifted(step * line_shift[d]);
+            covered += step;
+        }
+
+        // discard runs that wrap around a row edge or leave the board
+        if (run.intersects(line_starts[d])) {
+            return true;
+        }
     }
+
+    return false;
 }
 
 void Space::print() const
 {
     std::stringstream output;
     output << std::string(width + 2, '+') << std::endl;
-    for (auto & row : desk)
+    for (int y = 0; y < static_cast<int>(height); ++y)
     {
         output << "+";
-        for (auto & point : row)
+        for (int x = 0; x < static_cast<int>(width); ++x)
         {
+            const auto point = get(x, y);
             if (point == -1) {
                 output << "-";
                 continue;
@@ -90,57 +125,47 @@ void Space::print() const
     std::cout << output.str() << std::flush;
 }
 
-#define CHECK(x1, y1, x2, y2, x3, y3)                                             \
-    if (const auto dat = is_same(array[x1][y1], array[x2][y2], array[x3][y3]);    \
-        dat != -1) {                                                              \
-        return dat;                                                               \
-    }
-
-signed Space::win_within_3x3(const int x, const int y)
+signed Space::check_win() const
 {
-    char array[3][3];
-    // Precompute starting iterator to avoid repeated calculations.
-    auto row_start = desk.begin() + y;
-    for (int i = 0; i < 3; ++i, ++row_start) {
-        std::memcpy(array[i], row_start->data() + x, 3);
-    }
-
-    auto is_same = [&](const char data1, const char data2, const char data3) -> signed
+    for (signed char player = 0; player < 2; ++player)
     {
-        if (data1 == data2 && data3 == data1) {
-            return data1;
+        if (has_line(stones_of[player])) {
+            return player;
         }
-        return -1;
-    };
-
-    CHECK(0, 0, 1, 0, 2, 0)
-    CHECK(0, 1, 1, 1, 2, 1)
-    CHECK(0, 2, 1, 2, 2, 2)
-    CHECK(0, 0, 0, 1, 0, 2)
-    CHECK(1, 0, 1, 1, 1, 2)
-    CHECK(2, 0, 2, 1, 2, 2)
-    CHECK(0, 0, 1, 1, 2, 2)
-    CHECK(0, 2, 1, 1, 2, 0)
-
+    }
     return -1;
 }
 
-signed Space::check_win()
+signed Space::check_win(const int x, const int y) const
 {
-    if (width == 3 && height == 3) {
-        return win_within_3x3(0, 0);
+    if (!in_range(x, y)) {
+        throw std::out_of_range("Index out of range");
     }
 
-    // Precompute the maximum starting positions.
-    const int max_x = width - 3;
-    const int max_y = height - 3;
-    for (int x = 0; x < max_x; x++) {
-        for (int y = 0; y < max_y; y++) {
-            if (const auto dat = win_within_3x3(x, y); dat != -1)
-            {
-                return dat;
-            }
+    const auto player = get(x, y);
+    if (player == -1) {
+        return -1;
+    }
+
+    const auto & board = stones_of[player];
+    const int reach = static_cast<int>(win_length) - 1;
+    for (const auto & [dx, dy] : line_direction)
+    {
+        // count the stones of the same player on both sides of (x, y), at most win_length - 1 each way
+        uint64_t run = 1;
+        for (int step = 1; step <= reach && in_range(x + dx * step, y + dy * step)
+            && board.test(index_of(x + dx * step, y + dy * step)); ++step) {
+            ++run;
+        }
+        for (int step = 1; step <= reach && in_range(x - dx * step, y - dy * step)
+            && board.test(index_of(x - dx * step, y - dy * step)); ++step) {
+            ++run;
+        }
+
+        if (run >= win_length) {
+            return player;
         }
     }
+
     return -1;
 }
@@ -0,0 +1,180 @@
+#include "sparse_space.h"
+
+#include <algorithm>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+
+SparseSpace::SparseSpace(const int new_win_length)
+{
+    set_win_length(new_win_length);
+}
+
+void SparseSpace::set_win_length(const int new_win_length)
+{
+    if (new_win_length < 1) {
+        throw std::invalid_argument("Invalid win length");
+    }
+
+    win_length = new_win_length;
+}
+
+const SparseSpace::Chunk * SparseSpace::find_chunk(const int x, const int y) const
+{
+    const auto it = chunks.find(chunk_key(x >> chunk_bits, y >> chunk_bits));
+    return it == chunks.end() ? nullptr : &it->second;
+}
+
+void SparseSpace::place(const int x, const int y, const signed char c)
+{
+    const auto key = chunk_key(x >> chunk_bits, y >> chunk_bits);
+    const auto bit = bit_of(x, y);
+
+    if (const auto it = chunks.find(key); it != chunks.end()) {
+        auto & chunk = it->second;
+        for (signed char player = 0; player < 2; ++player) {
+            if (chunk.stones_of[player] & bit) {
+                chunk.stones_of[player] &= ~bit;
+                zobrist_hash ^= Space::zobrist_key(x, y, player);
+                --stone_total;
+            }
+        }
+        if (c != 0 && c != 1) {
+            if (chunk.empty()) {
+                chunks.erase(it);
+            }
+            return;
+        }
+    } else if (c != 0 && c != 1) {
+        return;
+    }
+
+    make_move(x, y, c);
+}
+
+signed char SparseSpace::get(const int x, const int y) const
+{
+    const auto * chunk = find_chunk(x, y);
+    if (chunk == nullptr) {
+        return -1;
+    }
+
+    const auto bit = bit_of(x, y);
+    if (chunk->stones_of[0] & bit) return 0;
+    if (chunk->stones_of[1] & bit) return 1;
+    return -1;
+}
+
+void SparseSpace::make_move(const int x, const int y, const signed char c)
+{
+    chunks[chunk_key(x >> chunk_bits, y >> chunk_bits)].stones_of[c] |= bit_of(x, y);
+    zobrist_hash ^= Space::zobrist_key(x, y, c);
+    ++stone_total;
+}
+
+void SparseSpace::unmake_move(const int x, const int y, const signed char c)
+{
+    chunks.find(chunk_key(x >> chunk_bits, y >> chunk_bits))->second.stones_of[c] &= ~bit_of(x, y);
+    zobrist_hash ^= Space::zobrist_key(x, y, c);
+    --stone_total;
+}
+
+uint64_t SparseSpace::run_length(int x, int y, const int dx, const int dy, const signed char c,
+                                 const uint64_t limit) const
+{
+    // the chunk is looked up again only when the walk crosses into another one
+    const Chunk * chunk = nullptr;
+    int chunk_x = 0, chunk_y = 0;
+    bool looked_up = false;
+
+    uint64_t run = 0;
+    while (run < limit) {
+        x += dx;
+        y += dy;
+        if (!looked_up || x >> chunk_bits != chunk_x || y >> chunk_bits != chunk_y) {
+            chunk_x = x >> chunk_bits;
+            chunk_y = y >> chunk_bits;
+            chunk = find_chunk(x, y);
+            looked_up = true;
+        }
+        if (chunk == nullptr || !(chunk->stones_of[c] & bit_of(x, y))) {
+            break;
+        }
+        ++run;
+    }
+    return run;
+}
+
+signed SparseSpace::check_win(const int x, const int y) const
+{
+    const auto player = get(x, y);
+    if (player == -1) {
+        return -1;
+    }
+
+    const auto reach = win_length - 1;
+    for (const auto & [dx, dy] : line_direction)
+    {
+        // count the stones of the same player on both sides of (x, y), at most win_length - 1 each way
+        const auto forward = run_length(x, y, dx, dy, player, reach);
+        if (1 + forward + run_length(x, y, -dx, -dy, player, reach - forward) >= win_length) {
+            return player;
+        }
+    }
+
+    return -1;
+}
+
+signed SparseSpace::check_win() const
+{
+    // any line of win_length runs through each of its stones, so checking every stone finds it.
+    // X is reported first when both players have a line, as Space does.
+    bool has_line[2] = { false, false };
+    for_each_stone([&](const int x, const int y, const signed char c) {
+        if (!has_line[c] && !has_line[0]) {
+            has_line[c] = check_win(x, y) == c;
+        }
+    });
+    return has_line[0] ? 0 : has_line[1] ? 1 : -1;
+}
+
+SparseSpace::Bounds SparseSpace::bounds() const
+{
+    Bounds box;
+    for_each_stone([&](const int x, const int y, signed char) {
+        if (box.empty()) {
+            box = { x, y, x, y };
+            return;
+        }
+        box.min_x = std::min(box.min_x, x);
+        box.min_y = std::min(box.min_y, y);
+        box.max_x = std::max(box.max_x, x);
+        box.max_y = std::max(box.max_y, y);
+    });
+    return box;
+}
+
+void SparseSpace::print() const
+{
+    const auto box = bounds();
+    std::stringstream output;
+    output << "(" << box.min_x << ", " << box.min_y << ")" << std::endl;
+    const int width = box.empty() ? 0 : box.max_x - box.min_x + 1;
+    output << std::string(width + 2, '+') << std::endl;
+    for (int y = box.min_y; y <= box.max_y; ++y)
+    {
+        output << "+";
+        for (int x = box.min_x; x <= box.max_x; ++x)
+        {
+            const auto point = get(x, y);
+            if (point == -1) {
+                output << "-";
+                continue;
+            }
+            output << (point == 0 ? 'X' : 'O');
+        }
+        output << "+\n";
+    }
+    output << std::string(width + 2, '+') << std::endl;
+    std::cout << output.str() << std::flush;
+}
@@ -0,0 +1,120 @@
+#include "symmetry.h"
+
+#include <stdexcept>
+
+namespace {
+    // where the stone on cell (x, y) ends up under each symmetry
+    constexpr int transformedCoordinate(const int x, const int y, const uint8_t transform)
+    {
+        switch (transform) {
+            case 0: return y * 3 + x;                   // identity
+            case 1: return x * 3 + (2 - y);             // rotate 90
+            case 2: return (2 - y) * 3 + (2 - x);       // rotate 180
+            case 3: return (2 - x) * 3 + y;             // rotate 270
+            case 4: return y * 3 + (2 - x);             // mirror left/right
+            case 5: return (2 - y) * 3 + x;             // mirror top/bottom
+            case 6: return x * 3 + y;                   // transpose
+            default: return (2 - x) * 3 + (2 - y);      // anti-transpose
+        }
+    }
+
+    struct SymmetryTables
+    {
+        uint8_t cell[symmetryCount][boardCells]{};
+        uint8_t inverseCell[symmetryCount][boardCells]{};
+        uint16_t mask[symmetryCount][1 << boardCells]{};
+
+        // canonical slot and transform of every board, and the board of every slot
+        uint16_t slotOfBoard[boardCount]{};
+        uint8_t transformOfBoard[boardCount]{};
+        uint16_t boardOfSlot[canonicalBoardCount]{};
+
+        SymmetryTables()
+        {
+            for (uint8_t t = 0; t < symmetryCount; ++t) {
+                for (int c = 0; c < static_cast<int>(boardCells); ++c) {
+                    cell[t][c] = transformedCoordinate(c % 3, c / 3, t);
+                    inverseCell[t][cell[t][c]] = c;
+                }
+                for (uint32_t m = 0; m < (1u << boardCells); ++m) {
+                    uint16_t moved = 0;
+                    for (uint32_t c = 0; c < boardCells; ++c) {
+                        if (m & (1u << c)) {
+                            moved |= 1u << cell[t][c];
+                        }
+                    }
+                    mask[t][m] = moved;
+                }
+            }
+
+            // canonical representative is the smallest board index in the symmetry group
+            uint32_t slots = 0;
+            for (uint32_t board = 0; board < boardCount; ++board) {
+                uint32_t bestBoard = boardCount;
+                uint8_t bestTransform = 0;
+                for (uint8_t t = 0; t < symmetryCount; ++t) {
+                    const uint32_t moved = transformBoard(board, t);
+                    if (moved < bestBoard) {
+                        bestBoard = moved;
+                        bestTransform = t;
+                    }
+                }
+                transformOfBoard[board] = bestTransform;
+                if (bestBoard == board) {
+                    boardOfSlot[slots] = board;
+                    slotOfBoard[board] = slots++;
+                }
+            }
+            if (slots != canonicalBoardCount) {
+                throw std::logic_error("Unexpected number of canonical boards");
+            }
+
+            // point every other board at the slot of its representative
+            for (uint32_t board = 0; board < boardCount; ++board) {
+                const auto canonical = transformBoard(board, transformOfBoard[board]);
+                slotOfBoard[board] = slotOfBoard[canonical];
+            }
+        }
+
+        static constexpr uint32_t pow3(const uint32_t exponent)
+        {
+            uint32_t result = 1;
+            for (uint32_t i = 0; i < exponent; ++i) {
+                result *= 3;
+            }
+            return result;
+        }
+
+        [[nodiscard]] uint32_t transformBoard(uint32_t board, const uint8_t t) const
+        {
+            uint32_t moved = 0;
+            for (uint32_t c = 0; c < boardCells; ++c, board /= 3) {
+                moved += (board % 3) * pow3(cell[t][c]);
+            }
+            return moved;
+        }
+    };
+
+    const SymmetryTables tables;
+}
+
+int transformCell(const int cell, const uint8_t transform) {
+    return tables.cell[transform][cell];
+}
+
+int inverseTransformCell(const int cell, const uint8_t transform) {
+    return tables.inverseCell[transform][cell];
+}
+
+uint32_t transformMask(const uint32_t mask, const uint8_t transform) {
+    return tables.mask[transform][mask];
+}
+
+CanonicalState canonicalize(const uint32_t state) {
+    const uint32_t board = state >> 1;
+    return { tables.slotOfBoard[board] * 2u + (state & 1), tables.transformOfBoard[board] };
+}
+
+uint32_t canonicalStateIndex(const uint32_t slot) {
+    return tables.boardOfSlot[slot >> 1] * 2u + (slot & 1);
+}
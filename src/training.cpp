@@ -0,0 +1,603 @@
+#include "training.h"
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cmath>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <utility>
+#include "static_space.h"
+#include "symmetry.h"
+#include "model.h"
+#include "work_stealing.h"
+#include "log.hpp"
+#include "metrics.hpp"
+
+namespace {
+    // (row, action) pairs of every move of an episode, actions are in the frame of the row
+    using History = std::vector<std::pair<uint32_t, int>>;
+
+    const metrics::counter episodesPlayed("xoxo_training_episodes_total", "Self-play episodes played");
+    const metrics::counter pliesPlayed("xoxo_training_plies_total", "Moves played in self-play episodes");
+    const metrics::counter qLookups("xoxo_training_qtable_lookups_total", "Q-table rows looked up to choose a move");
+    const metrics::counter newStatesSeen("xoxo_training_new_states_total", "Q-table rows visited for the first time");
+    const metrics::gauge qtableStates("xoxo_qtable_states", "Visited rows of the last trained or merged Q-table");
+    const metrics::histogram batchSeconds("xoxo_training_batch_seconds", "Time to play one batch of episodes",
+                                          metrics::latency_buckets());
+    const metrics::histogram mergeSeconds("xoxo_training_merge_seconds", "Time to merge the per-thread Q-tables",
+                                          metrics::latency_buckets());
+    const metrics::histogram checkpointSeconds("xoxo_training_checkpoint_seconds", "Time to snapshot and write a checkpoint",
+                                               metrics::latency_buckets());
+
+    // Learning statistics of a batch of episodes, see EarlyStopping.
+    struct BatchStats
+    {
+        double maxDelta = 0.0;
+        double sumDelta = 0.0;
+        unsigned long long updates = 0;
+        unsigned long long newStates = 0;
+
+        void add(const BatchStats &other)
+        {
+            maxDelta = std::max(maxDelta, other.maxDelta);
+            sumDelta += other.sumDelta;
+            updates += other.updates;
+            newStates += other.newStates;
+        }
+    };
+
+    // Collects batch statistics from all training threads into windows and decides when to stop.
+    // Threads report once per batch, so the lock is taken rarely. Completed windows are judged by
+    // train() on its own thread, against a snapshot of everything learned so far (the merge of all
+    // per-thread tables), so no worker waits for a probe.
+    class ConvergenceMonitor
+    {
+    private:
+        const EarlyStopping &rules;
+        // largest |delta Q| allowed, see EarlyStopping::maxDeltaQ
+        const double maxDeltaQ;
+        std::mutex mutex;
+        std::condition_variable windowClosed;
+        BatchStats window;
+        unsigned int windowBatches = 0;
+        // completed windows that wait to be judged, those that complete while one is judged join it
+        BatchStats closedWindow;
+        bool windowPending = false;
+        bool finished = false;
+        unsigned int passedWindows = 0;
+        bool hasProbe = false;
+        ProbeResult lastProbe;
+        uint32_t lastStates = 0;
+        std::atomic<bool> stop{false};
+
+        static double rate(const unsigned long long count, const ProbeResult &probe)
+        {
+            return static_cast<double>(count) / std::max(1ULL, probe.games());
+        }
+
+        // change of a rate between two probes plus two standard errors of that difference, so it
+        // stays within a tolerance only if the true change most likely does
+        static double rateChange(const unsigned long long count, const ProbeResult &probe,
+                                 const unsigned long long lastCount, const ProbeResult &last)
+        {
+            const double p = rate(count, probe), q = rate(lastCount, last);
+            const double error = std::sqrt(p * (1 - p) / std::max(1ULL, probe.games())
+                                           + q * (1 - q) / std::max(1ULL, last.games()));
+            return std::abs(p - q) + 2 * error;
+        }
+
+    public:
+        ConvergenceMonitor(const EarlyStopping &rules, const double alpha, const uint32_t initialStates)
+            : rules(rules), maxDeltaQ(rules.maxDeltaQ > 0 ? rules.maxDeltaQ : 0.95 * alpha), lastStates(initialStates)
+        { }
+
+        [[nodiscard]] bool stopped() const { return stop.load(std::memory_order_relaxed); }
+
+        // Add a finished batch, a window it completes is handed to nextWindow.
+        void addBatch(const BatchStats &batch)
+        {
+            if (!rules.enabled) {
+                return;
+            }
+            std::lock_guard lock(mutex);
+            window.add(batch);
+            if (++windowBatches < std::max(1u, rules.windowBatches)) {
+                return;
+            }
+            closedWindow.add(std::exchange(window, {}));
+            windowPending = true;
+            windowBatches = 0;
+            windowClosed.notify_one();
+        }
+
+        // every training thread is done, windows still pending are not judged
+        void finish()
+        {
+            std::lock_guard lock(mutex);
+            finished = true;
+            windowClosed.notify_one();
+        }
+
+        // Wait for the next completed window, false once training has finished.
+        bool nextWindow(BatchStats &closed)
+        {
+            std::unique_lock lock(mutex);
+            windowClosed.wait(lock, [&] { return finished || windowPending; });
+            if (finished || !rules.enabled) {
+                return false;
+            }
+            closed = std::exchange(closedWindow, {});
+            windowPending = false;
+            return true;
+        }
+
+        // judge a window with the probe of a snapshot of every table, holding states rows in all
+        void closeWindow(const BatchStats &closed, const ProbeResult &probe, const uint32_t states)
+        {
+            std::lock_guard lock(mutex);
+            const double meanDelta = closed.sumDelta / std::max(1ULL, closed.updates);
+            const uint32_t newStates = states - std::min(states, lastStates);
+            const double winChange = hasProbe ? rateChange(probe.wins, probe, lastProbe.wins, lastProbe) : 1.0;
+            const double drawChange = hasProbe ? rateChange(probe.draws, probe, lastProbe.draws, lastProbe) : 1.0;
+            const bool passed = hasProbe
+                && closed.maxDelta <= maxDeltaQ
+                && meanDelta <= rules.meanDeltaQ
+                && newStates <= rules.maxNewStates
+                && winChange <= rules.probeTolerance
+                && drawChange <= rules.probeTolerance;
+            passedWindows = passed ? passedWindows + 1 : 0;
+            lastProbe = probe;
+            lastStates = states;
+            hasProbe = true;
+
+            debug::log<debug::INFO>("window: max |dQ| ", closed.maxDelta,
+                                    ", mean |dQ| ", meanDelta, ", new states ", newStates,
+                                    ", probe win ", rate(probe.wins, probe), " draw ", rate(probe.draws, probe),
+                                    " (change with noise ", winChange, " / ", drawChange, ")",
+                                    passed ? " (converged)\n" : "\n");
+            if (passedWindows >= std::max(1u, rules.patience)) {
+                stop.store(true, std::memory_order_relaxed);
+            }
+        }
+    };
+
+    // Progress of one training thread, shared with the checkpoint thread.
+    struct Worker
+    {
+        // moves played, only read once the worker has finished
+        unsigned long long plies = 0;
+        std::atomic<unsigned long long> done{0};
+        std::atomic<bool> finished{false};
+
+        // Checkpoint handshake: the checkpoint thread raises *requested, the worker copies its table
+        // into snapshot between two episodes and then publishes the generation it copied.
+        const std::atomic<uint64_t> *requested = nullptr;
+        std::atomic<uint64_t> acknowledged{0};
+        DenseQTable snapshot;
+        unsigned long long snapshotEpisodes = 0;
+    };
+
+    template <bool Shared>
+    double loadQ(const DenseQTable &Q, const uint32_t state, const int action) {
+        if constexpr (Shared) {
+            return Q.loadShared(state, action);
+        } else {
+            return Q.row(state)[action];
+        }
+    }
+
+    // Legal move with the highest Q-value, the lowest cell wins ties.
+    template <bool Shared>
+    int greedyAction(const DenseQTable &Q, const uint32_t state, const uint32_t legalMoves) {
+        double bestValue = -1e9;
+        int bestAction = std::countr_zero(legalMoves);
+        for (uint32_t moves = legalMoves; moves; moves &= moves - 1) {
+            const int a = std::countr_zero(moves);
+            if (const double value = loadQ<Shared>(Q, state, a); value > bestValue) {
+                bestValue = value;
+                bestAction = a;
+            }
+        }
+        return bestAction;
+    }
+
+    // Uniformly random legal move.
+    template <typename Generator>
+    int randomAction(const uint32_t legalMoves, Generator &gen) {
+        // pick the n-th empty cell
+        std::uniform_int_distribution<> moveDis(0, std::popcount(legalMoves) - 1);
+        uint32_t moves = legalMoves;
+        for (int skip = moveDis(gen); skip > 0; --skip) {
+            moves &= moves - 1;
+        }
+        return std::countr_zero(moves);
+    }
+
+    // Row and symmetry used to look up a board in Q.
+    CanonicalState lookup(const DenseQTable &Q, const Board3x3 &game, const char currentPlayer) {
+        const uint32_t rawState = getStateIndex(static_cast<uint32_t>(game.stones(0)), static_cast<uint32_t>(game.stones(1)),
+                                                currentPlayer);
+        return Q.isCanonical() ? canonicalize(rawState) : CanonicalState{ rawState, 0 };
+    }
+
+    // Update all moves in history in reverse order, starting from the final reward.
+    template <bool Shared>
+    void backpropagate(DenseQTable &Q, const History &history, const double reward, const TrainingConfig &config,
+                       BatchStats &stats) {
+        double target = reward;
+        for (auto it = history.rbegin(); it != history.rend(); ++it) {
+            const auto [s, a] = *it;
+            double delta;
+            if constexpr (Shared) {
+                const double q = Q.loadShared(s, a);
+                delta = config.alpha * (target - q);
+                Q.storeShared(s, a, q + delta);
+            } else {
+                double &q = Q.row(s)[a];
+                delta = config.alpha * (target - q);
+                q += delta;
+            }
+            stats.maxDelta = std::max(stats.maxDelta, std::abs(delta));
+            stats.sumDelta += std::abs(delta);
+            target *= config.discount;
+        }
+        stats.updates += history.size();
+    }
+
+    // Play one self-play episode and learn from it, returns the number of moves played.
+    template <bool Shared>
+    unsigned int playEpisode(DenseQTable &Q, const TrainingConfig &config, std::mt19937 &gen, History &history,
+                             BatchStats &stats) {
+        std::uniform_real_distribution<> dis(0.0, 1.0);
+        Board3x3 game;
+        char currentPlayer = 'X';  // start with X
+        history.clear();
+
+        while (true) {
+            // Actions are chosen and learned in the frame of the row's board.
+            const auto [state, transform] = lookup(Q, game, currentPlayer);
+            const uint32_t legalMoves = transformMask(static_cast<uint32_t>(game.empty_cells()), transform);
+            if constexpr (Shared) {
+                stats.newStates += Q.visitShared(state);
+            } else {
+                stats.newStates += !Q.isVisited(state);
+                Q.row(state);
+            }
+
+            // Epsilon-greedy action selection.
+            const int action = dis(gen) < config.epsilon
+                ? randomAction(legalMoves, gen)
+                : greedyAction<Shared>(Q, state, legalMoves);
+            history.emplace_back(state, action);
+            const int cell = inverseTransformCell(action, transform);
+            // Place the symbol: X is represented by 0, O by 1. The cell is a legal move, so it is empty.
+            signed char symbol = (currentPlayer == 'X') ? 0 : 1;
+            game.make_move(cell, symbol);
+
+            // Check for a win, only on the lines through the new stone.
+            if (game.wins(cell, symbol)) {
+                // The player who just moved wins, rewarded from their perspective.
+                backpropagate<Shared>(Q, history, 1.0, config, stats);
+                break;
+            }
+            if (game.full()) {
+                // Board is full; it's a draw.
+                backpropagate<Shared>(Q, history, 0.0, config, stats);
+                break;
+            }
+            // Switch player and continue.
+            currentPlayer = (currentPlayer == 'X') ? 'O' : 'X';
+        }
+        return static_cast<unsigned int>(history.size());
+    }
+
+    // Worker loop of train(): run batches until every batch has been claimed.
+    template <bool Shared>
+    void runBatches(WorkStealingRanges &batches, const unsigned int index, const unsigned long long numEpisodes,
+                    DenseQTable &Q, const TrainingConfig &config, Worker &worker, ConvergenceMonitor &monitor) {
+        std::mt19937 gen(std::random_device{}());
+        History history;
+        history.reserve(boardCells);
+        unsigned long long done = 0;
+
+        for (uint32_t batch; !monitor.stopped() && batches.next(index, batch); ) {
+            BatchStats stats;
+            const auto batchStart = std::chrono::steady_clock::now();
+            const auto pliesBefore = worker.plies;
+            if (config.seed != 0) {
+                gen.seed(static_cast<std::mt19937::result_type>(config.seed + batch));
+            }
+            const unsigned long long first = static_cast<unsigned long long>(batch) * config.batchSize;
+            const unsigned long long last = std::min(first + config.batchSize, numEpisodes);
+            for (unsigned long long episode = first; episode < last; ++episode) {
+                debug::log<debug::DEBUG>(episode, "/", numEpisodes, " ...\n");
+                worker.plies += playEpisode<Shared>(Q, config, gen, history, stats);
+                worker.done.store(++done, std::memory_order_relaxed);
+
+                if constexpr (!Shared) {
+                    if (const auto generation = worker.requested->load(std::memory_order_acquire);
+                        generation != worker.acknowledged.load(std::memory_order_relaxed))
+                    {
+                        worker.snapshot = Q;
+                        worker.snapshotEpisodes = done;
+                        worker.acknowledged.store(generation, std::memory_order_release);
+                    }
+                }
+            }
+
+            const auto batchPlies = worker.plies - pliesBefore;
+            episodesPlayed.inc(last - first);
+            pliesPlayed.inc(batchPlies);
+            qLookups.inc(batchPlies);
+            newStatesSeen.inc(stats.newStates);
+            batchSeconds.observe(std::chrono::duration<double>(std::chrono::steady_clock::now() - batchStart).count());
+
+            monitor.addBatch(stats);
+        }
+
+        worker.finished.store(true, std::memory_order_release);
+    }
+}
+
+void trainEpisodes(const unsigned long long episodes, DenseQTable &Q, const TrainingConfig &config) {
+    std::mt19937 gen(config.seed != 0 ? static_cast<std::mt19937::result_type>(config.seed) : std::random_device{}());
+    History history;
+    history.reserve(boardCells);
+    BatchStats stats;
+    for (unsigned long long episode = 0; episode < episodes; ++episode) {
+        debug::log<debug::DEBUG>(episode, "/", episodes, " ...\n");
+        if (config.hogwild) {
+            playEpisode<true>(Q, config, gen, history, stats);
+        } else {
+            playEpisode<false>(Q, config, gen, history, stats);
+        }
+    }
+}
+
+DenseQTable mergeQTables(const std::vector<DenseQTable> &tables, const unsigned int numThreads) {
+    std::vector<const DenseQTable *> pointers;
+    pointers.reserve(tables.size());
+    for (const auto &qt : tables) {
+        pointers.push_back(&qt);
+    }
+    return mergeQTables(pointers, numThreads);
+}
+
+DenseQTable mergeQTables(const std::vector<const DenseQTable *> &tables, unsigned int numThreads) {
+    const metrics::scoped_timer timer(mergeSeconds);
+    DenseQTable merged(!tables.empty() && tables.front()->isCanonical());
+    if (numThreads == 0) {
+        numThreads = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    // The rows are cut into contiguous shards that threads claim one at a time, so every row is
+    // reduced by exactly one thread and written straight into the merged table.
+    const uint32_t rows = merged.rowCount();
+    const uint32_t shardCount = std::min(rows, numThreads * 8);
+    std::atomic<uint32_t> nextShard{0};
+    auto reduceShards = [&] {
+        for (uint32_t shard; (shard = nextShard.fetch_add(1, std::memory_order_relaxed)) < shardCount; ) {
+            const uint32_t first = static_cast<uint64_t>(rows) * shard / shardCount;
+            const uint32_t last = static_cast<uint64_t>(rows) * (shard + 1) / shardCount;
+            for (uint32_t state = first; state < last; ++state) {
+                int count = 0;
+                double sum[boardCells] = {};
+                for (const auto *qt : tables) {
+                    if (!qt->isVisited(state)) {
+                        continue;
+                    }
+                    const double *qvals = qt->row(state);
+                    for (uint32_t a = 0; a < boardCells; ++a) {
+                        sum[a] += qvals[a];
+                    }
+                    count++;
+                }
+                if (count == 0) {
+                    continue;
+                }
+                // rows of different shards never overlap, the shared accessors only keep the
+                // visited counter consistent
+                merged.visitShared(state);
+                for (uint32_t a = 0; a < boardCells; ++a) {
+                    merged.storeShared(state, a, sum[a] / count);
+                }
+            }
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (unsigned int i = 1; i < numThreads && i < shardCount; i++) {
+        threads.emplace_back(reduceShards);
+    }
+    reduceShards();
+    for (auto &t : threads) {
+        t.join();
+    }
+    return merged;
+}
+
+DenseQTable train(const unsigned long long numEpisodes, unsigned int numThreads, const TrainingConfig &config,
+                  const CheckpointConfig &checkpoint, const DenseQTable *resumeFrom,
+                  const unsigned long long resumeEpisodes, TrainingStats *stats) {
+    if (numThreads == 0) {
+        numThreads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    // Episodes are handed out in batches, idle threads steal batches from busy ones.
+    const unsigned long long batchSize = std::max(1u, config.batchSize);
+    const auto batchCount = static_cast<uint32_t>((numEpisodes + batchSize - 1) / batchSize);
+    WorkStealingRanges batches(batchCount, numThreads);
+
+    // Every table starts from the checkpoint, in the layout this run learns in.
+    DenseQTable initial(config.useSymmetry);
+    if (resumeFrom != nullptr && resumeFrom->isCanonical() == config.useSymmetry) {
+        initial = *resumeFrom;
+    } else if (resumeFrom != nullptr) {
+        initial.fromQTable(resumeFrom->toQTable());
+    }
+
+    // One table for everyone in Hogwild mode, otherwise one per thread.
+    std::vector<DenseQTable> tables(config.hogwild ? 1 : numThreads, initial);
+    std::vector<Worker> workers(numThreads);
+    ConvergenceMonitor monitor(config.earlyStopping, config.alpha, initial.size());
+    // snapshots are taken by the checkpoint thread and by early stopping, one at a time
+    std::mutex snapshotMutex;
+    uint64_t generation = 0;
+    std::atomic<uint64_t> requested{0};
+
+    // Merge the tables as they are right now, episodes receives the episode count they hold.
+    auto takeSnapshot = [&](unsigned long long &episodes) {
+        std::lock_guard lock(snapshotMutex);
+        episodes = resumeEpisodes;
+        DenseQTable snapshot;
+        if (config.hogwild) {
+            for (const auto &worker : workers) {
+                episodes += worker.done.load(std::memory_order_relaxed);
+            }
+            snapshot = tables.front().sharedSnapshot();
+        } else {
+            requested.store(++generation, std::memory_order_release);
+            std::vector<const DenseQTable *> copies;
+            for (unsigned int i = 0; i < numThreads; i++) {
+                auto &worker = workers[i];
+                // a finished thread no longer touches its table, so it is used as it is
+                while (worker.acknowledged.load(std::memory_order_acquire) != generation
+                    && !worker.finished.load(std::memory_order_acquire)) {
+                    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                }
+                if (worker.acknowledged.load(std::memory_order_acquire) == generation) {
+                    copies.push_back(&worker.snapshot);
+                    episodes += worker.snapshotEpisodes;
+                } else {
+                    copies.push_back(&tables[i]);
+                    episodes += worker.done.load(std::memory_order_relaxed);
+                }
+            }
+            snapshot = mergeQTables(copies);
+        }
+        return snapshot;
+    };
+
+    // Write the merged tables out with the episode count.
+    auto writeCheckpoint = [&] {
+        const metrics::scoped_timer timer(checkpointSeconds);
+        unsigned long long episodes = 0;
+        const DenseQTable snapshot = takeSnapshot(episodes);
+        if (writeModel(snapshot, checkpoint.path, episodes)) {
+            debug::log<debug::INFO>("Checkpoint of ", episodes, " episodes written to ", checkpoint.path, "\n");
+        }
+    };
+
+    // Launch training threads.
+    std::vector<std::thread> threads;
+    std::atomic<unsigned int> running{numThreads};
+    for (unsigned int i = 0; i < numThreads; i++) {
+        workers[i].requested = &requested;
+        DenseQTable &Q = tables[config.hogwild ? 0 : i];
+        threads.emplace_back([&, i] {
+            if (config.hogwild) {
+                runBatches<true>(batches, i, numEpisodes, Q, config, workers[i], monitor);
+            } else {
+                runBatches<false>(batches, i, numEpisodes, Q, config, workers[i], monitor);
+            }
+            if (running.fetch_sub(1) == 1) {
+                monitor.finish();
+            }
+        });
+    }
+
+    // Checkpoint periodically until training is done.
+    std::mutex stopMutex;
+    std::condition_variable stopSignal;
+    bool stopping = false;
+    std::thread checkpointThread;
+    if (checkpoint.intervalSeconds > 0) {
+        checkpointThread = std::thread([&] {
+            std::unique_lock lock(stopMutex);
+            while (!stopSignal.wait_for(lock, std::chrono::seconds(checkpoint.intervalSeconds),
+                                        [&] { return stopping; })) {
+                lock.unlock();
+                writeCheckpoint();
+                lock.lock();
+            }
+        });
+    }
+
+    // Judge every window the workers complete with the fixed-seed probe of the merged tables, the
+    // policy train() would return, until training is done.
+    for (BatchStats window; monitor.nextWindow(window); ) {
+        unsigned long long episodes = 0;
+        const DenseQTable snapshot = takeSnapshot(episodes);
+        constexpr uint64_t probeSeed = 0x5eed;
+        monitor.closeWindow(window, probeAgainstRandom(snapshot, config.earlyStopping.probeGames, probeSeed),
+                            snapshot.size());
+    }
+
+    // Wait for all threads to complete.
+    for (auto &t : threads) {
+        t.join();
+    }
+    if (checkpointThread.joinable()) {
+        {
+            std::lock_guard lock(stopMutex);
+            stopping = true;
+        }
+        stopSignal.notify_all();
+        checkpointThread.join();
+    }
+
+    if (stats != nullptr) {
+        *stats = {};
+        for (const auto &worker : workers) {
+            stats->episodes += worker.done.load(std::memory_order_relaxed);
+            stats->plies += worker.plies;
+        }
+        stats->converged = monitor.stopped();
+    }
+
+    DenseQTable result = config.hogwild ? std::move(tables.front()) : mergeQTables(tables);
+    qtableStates.set(static_cast<double>(result.size()));
+    return result;
+}
+
+uint64_t trainingTableBytes(const DenseQTable &Q, unsigned int numThreads, const bool hogwild) {
+    if (numThreads == 0) {
+        numThreads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    return Q.bytes() * (hogwild ? 1 : numThreads + 1);
+}
+
+ProbeResult probeAgainstRandom(const DenseQTable &Q, const unsigned long long games, const uint64_t seed) {
+    std::mt19937_64 gen(seed);
+    ProbeResult result;
+    for (unsigned long long g = 0; g < games; ++g) {
+        const char agent = (g % 2 == 0) ? 'X' : 'O';
+        Board3x3 game;
+        char currentPlayer = 'X';
+        while (true) {
+            const uint32_t legalMoves = static_cast<uint32_t>(game.empty_cells());
+            int cell;
+            if (currentPlayer == agent) {
+                const auto [state, transform] = lookup(Q, game, currentPlayer);
+                cell = inverseTransformCell(greedyAction<false>(Q, state, transformMask(legalMoves, transform)), transform);
+            } else {
+                cell = randomAction(legalMoves, gen);
+            }
+            game.make_move(cell, currentPlayer == 'X' ? 0 : 1);
+
+            if (const int winner = game.check_win(cell); winner != -1) {
+                ((winner == 0) == (agent == 'X') ? result.wins : result.losses)++;
+                break;
+            }
+            if (game.full()) {
+                result.draws++;
+                break;
+            }
+            currentPlayer = (currentPlayer == 'X') ? 'O' : 'X';
+        }
+    }
+    return result;
+}
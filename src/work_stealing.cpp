@@ -0,0 +1,60 @@
+#include "work_stealing.h"
+
+WorkStealingRanges::WorkStealingRanges(const uint32_t count, const unsigned int workers)
+    : ranges(workers)
+{
+    for (unsigned int i = 0; i < workers; ++i) {
+        const auto begin = static_cast<uint32_t>(static_cast<uint64_t>(count) * i / workers);
+        const auto end = static_cast<uint32_t>(static_cast<uint64_t>(count) * (i + 1) / workers);
+        ranges[i].bounds.store(pack(begin, end), std::memory_order_relaxed);
+    }
+}
+
+bool WorkStealingRanges::next(const unsigned int worker, uint32_t &item)
+{
+    auto &own = ranges[worker].bounds;
+    while (true) {
+        uint64_t bounds = own.load(std::memory_order_acquire);
+        while (beginOf(bounds) < endOf(bounds)) {
+            if (own.compare_exchange_weak(bounds, pack(beginOf(bounds) + 1, endOf(bounds)),
+                                          std::memory_order_acq_rel, std::memory_order_acquire)) {
+                item = beginOf(bounds);
+                return true;
+            }
+        }
+        if (!steal(worker)) {
+            return false;
+        }
+    }
+}
+
+bool WorkStealingRanges::steal(const unsigned int worker)
+{
+    while (true) {
+        // victim with the most work left
+        unsigned int victim = worker;
+        uint64_t victimBounds = 0;
+        uint32_t most = 0;
+        for (unsigned int i = 0; i < ranges.size(); ++i) {
+            const uint64_t bounds = ranges[i].bounds.load(std::memory_order_acquire);
+            if (const uint32_t left = endOf(bounds) - beginOf(bounds); i != worker && beginOf(bounds) < endOf(bounds) && left > most) {
+                most = left;
+                victim = i;
+                victimBounds = bounds;
+            }
+        }
+        if (victim == worker) {
+            return false;
+        }
+
+        // the victim keeps the front half, a single item is taken whole
+        const uint32_t begin = beginOf(victimBounds), end = endOf(victimBounds);
+        const uint32_t middle = begin + (end - begin) / 2;
+        if (ranges[victim].bounds.compare_exchange_strong(victimBounds, pack(begin, middle),
+                                                          std::memory_order_acq_rel, std::memory_order_acquire)) {
+            // only the owner refills its own range, and only while it is empty
+            ranges[worker].bounds.store(pack(middle, end), std::memory_order_release);
+            return true;
+        }
+    }
+}
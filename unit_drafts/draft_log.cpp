@@ -1,5 +1,8 @@
 #include "log.hpp"
 
+#include <atomic>
+#include <chrono>
+#include <thread>
 #include <vector>
 
 static const std::vector<int> containers = {1, 2, 3, 4, 5, 6, 7, 8};
@@ -7,4 +10,40 @@ static const std::vector<int> containers = {1, 2, 3, 4, 5, 6, 7, 8};
 int main()
 {
     debug::log(debug::error_log, containers, "\n");
+
+    // the same records through the background writer, from several threads at once
+    debug::start_async_log();
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t) {
+        threads.emplace_back([t] {
+            for (int i = 0; i < 3; ++i) {
+                debug::log(debug::error_log, "thread ", t, " record ", i, " ", containers, "\n");
+            }
+        });
+    }
+    for (auto &thread : threads) {
+        thread.join();
+    }
+    debug::stop_async_log();
+    debug::log(debug::error_log, "dropped ", debug::dropped_log_records(), "\n");
+
+    // stop while producers wait on full rings under the block policy, they must all get through
+    debug::start_async_log(64, debug::overflow_policy::block);
+    std::atomic<int> finished = 0;
+    threads.clear();
+    for (int t = 0; t < 4; ++t) {
+        threads.emplace_back([t, &finished] {
+            for (int i = 0; i < 2000; ++i) {
+                debug::log(debug::error_log, "blocked thread ", t, " record ", i, "\n");
+            }
+            ++finished;
+        });
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    debug::stop_async_log();
+    for (auto &thread : threads) {
+        thread.join();
+    }
+    debug::log(debug::error_log, "stopped with ", 4 - finished.load(), " producers still running, dropped ",
+               debug::dropped_log_records(), "\n");
 }
@@ -1,4 +1,7 @@
 #include "space.h"
+#include "sparse_space.h"
+
+#include <iostream>
 
 int main()
 {
@@ -8,5 +11,26 @@ int main()
     space.place(2, 1, 1);
     space.place(3, 2, 1);
     space.print();
-    auto a = space.check_win();
+    const signed a = space.check_win();
+    std::cout << "winner " << a << " (expected 1)\n";
+
+    Space gomoku(15, 15, 5);
+    for (int i = 0; i < 5; ++i) {
+        gomoku.place(10 - i, 3 + i, 0);
+    }
+    gomoku.print();
+    const signed b = gomoku.check_win();
+    const signed c = gomoku.check_win(8, 5);
+    std::cout << "winner " << b << ", through (8, 5) " << c << " (expected 0, 0)\n";
+
+    // the same diagonal shifted across the origin, through four chunks
+    SparseSpace open_board(5);
+    for (int i = 0; i < 5; ++i) {
+        open_board.place(2 - i, -2 + i, 0);
+    }
+    open_board.print();
+    const signed d = open_board.check_win(0, 0);
+    std::cout << "winner through the origin " << d << " (expected 0)\n";
+
+    return a == 1 && b == 0 && c == 0 && d == 0 ? 0 : 1;
 }